@@ -1,6 +1,6 @@
 
 
-#version 330 core
+#version 430 core
 
 out vec4 color;
 
@@ -10,19 +10,31 @@ in vec3 frag_normal;
 uniform vec3 lightPos; 
 uniform vec3 viewPos;
 uniform vec3 lightColour;
+
+#ifdef INDIRECT
+flat in vec3 frag_colour;
+#else
 uniform vec3 objectColour;
-uniform float fade;
-uniform float wireframe;
+#endif
+
+// Variants are built with any of FADE, WIREFRAME, FLAT_SHADING and INDIRECT defined
 
 void main()
 {
+#ifdef WIREFRAME
+	vec3 result = vec3(0.0f);
+#else
 	// Ambient
 	float ambientStrength = 0.2f;
 
 	vec3 ambient = ambientStrength * lightColour;
   	
 	// Diffuse 
+#ifdef FLAT_SHADING
+	vec3 norm = normalize(cross(dFdx(frag_pos), dFdy(frag_pos)));
+#else
 	vec3 norm = normalize(frag_normal);
+#endif
 	vec3 lightDir = normalize(lightPos - frag_pos);
 	float diff = max(dot(norm, lightDir), 0.0);
 	vec3 diffuse = diff * lightColour;
@@ -34,11 +46,18 @@ void main()
 	float spec = pow(max(dot(viewDir, reflectDir), 0.0), 32);
 	vec3 specular = specularStrength * spec * lightColour; 
 
+#ifdef INDIRECT
+	vec3 result = (ambient + diffuse + specular) * frag_colour;
+#else
 	vec3 result = (ambient + diffuse + specular) * objectColour;
+#endif
+#endif
 
-	float dist = distance(viewPos, frag_pos);
- 
-	float opacity = clamp(dist / 10.0f, 0.0f, 1.0f) * fade;
+#ifdef FADE
+	float opacity = clamp(distance(viewPos, frag_pos) / 10.0f, 0.0f, 1.0f);
+#else
+	float opacity = 0.0f;
+#endif
 
-	color = vec4(result * wireframe, 1.0f - opacity);
+	color = vec4(result, 1.0f - opacity);
 } 
\ No newline at end of file
@@ -1,10 +1,7 @@
 
 
 
-#version 330 core
-
-uniform mat4 projectionMatrix;
-uniform mat4 modelViewMatrix;
+#version 430 core
 
 layout (location = 0) in vec3 in_position;
 layout (location = 1) in vec3 in_normal;
@@ -12,9 +9,46 @@ layout (location = 1) in vec3 in_normal;
 out vec3 frag_normal;
 out vec3 frag_pos;
 
+#ifdef INDIRECT
+// One entry per draw of a multi-draw, selected by the draw's base instance
+struct DrawData
+{
+	mat4 modelMatrix;
+	mat4 normalMatrix;
+	vec4 colour;
+};
+
+layout (std430, binding = 0) readonly buffer Draws
+{
+	DrawData draws[];
+};
+
+uniform mat4 viewProjectionMatrix;
+
+layout (location = 2) in uint in_drawId;
+
+flat out vec3 frag_colour;
+
+void main()
+{
+    DrawData draw = draws[in_drawId];
+
+    vec4 worldPos = draw.modelMatrix * vec4(in_position, 1.0f);
+
+    gl_Position = viewProjectionMatrix * worldPos;
+    frag_pos = vec3(worldPos);
+    frag_normal = mat3(draw.normalMatrix) * in_normal;
+    frag_colour = draw.colour.rgb;
+}
+#else
+uniform mat4 modelViewMatrix;
+uniform mat4 modelViewProjectionMatrix;
+uniform mat4 normalMatrix;	// transpose(inverse(modelViewMatrix)), computed once per object on the CPU
+
 void main()
 {
-    gl_Position = (projectionMatrix * modelViewMatrix) * vec4(in_position, 1.0f);
+    gl_Position = modelViewProjectionMatrix * vec4(in_position, 1.0f);
     frag_pos = vec3(modelViewMatrix * vec4(in_position, 1.0f));
-    frag_normal = mat3(transpose(inverse(modelViewMatrix))) * in_normal;  
-} 
\ No newline at end of file
+    frag_normal = mat3(normalMatrix) * in_normal;
+}
+#endif 
\ No newline at end of file
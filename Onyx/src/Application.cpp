@@ -3,11 +3,24 @@
 
 #include "SFML\Window\Event.hpp"
 
+#include "profiling\Profiler.hpp"
+#include "profiling\GpuProfiler.hpp"
+
+#include "jobs\JobSystem.hpp"
+
+#include "rendering\MeshCache.hpp"
+#include "rendering\MeshPool.hpp"
+
+#include <algorithm>
 #include <string>
 #include <iostream>
 #include <random>
+#include <thread>
 
 Application::Application()
+	:
+	pacer(timePerFrame),
+	renderPacer(timePerFrame)
 {
 	sf::ContextSettings settings;
 	settings.majorVersion = 4;
@@ -16,6 +29,10 @@ Application::Application()
 	settings.antialiasingLevel = 4;
 	settings.attributeFlags = settings.Core;
 
+	PROFILE_THREAD("Main");
+
+	JobSystem::init();
+
 	std::cout << "\nCreating Window..." << std::endl;
 
 	// Create window first so when we init opencl we can use the opengl context
@@ -31,17 +48,30 @@ Application::Application()
 
 	m_isOpen = (GLEW_OK == err);
 
+	if (m_isOpen)
+	{
+		GpuProfiler::init();
+	}
+
 	graphics.init(&window);
+
+	pacer.setFrameRateLimit(60);
+	pacer.setMaxUpdateSteps(5);
+	pacer.setReportInterval(sf::Time::Zero);
+
+	renderPacer.setFrameRateLimit(60);
 }
 
 void Application::getInput()
 {
+	PROFILE_SCOPE("Input");
+
+	std::vector<sf::Event> events;
+
 	sf::Event event;
 
 	while (window.pollEvent(event))
 	{
-		graphics.handleEvent(event, timePerFrame);
-
 		// Close window: exit
 		if (event.type == sf::Event::Closed)
 		{
@@ -56,48 +86,231 @@ void Application::getInput()
 		{
 			//capture.create(window.getSize().x, window.getSize().y);
 		}
+		// F9 key: start/stop recording input
+		if ((event.type == sf::Event::KeyPressed) && (event.key.code == sf::Keyboard::F9))
+		{
+			toggleInputRecording();
+			continue;
+		}
+		// F12 key: start/stop a profiler capture
+		if ((event.type == sf::Event::KeyPressed) && (event.key.code == sf::Keyboard::F12))
+		{
+			toggleProfilerCapture();
+		}
+
+		events.push_back(event);
+	}
+
+	m_input = InputState::capture();
+
+	m_replay.processTick(events, m_input);
+
+	for (auto& e : events)
+	{
+		graphics.handleEvent(e, timePerFrame);
+	}
+
+	if (m_replay.playbackFinished())
+	{
+		std::cout << "\nInput replay finished" << std::endl;
+
+		close();
+	}
+}
+
+Model& Application::addModel(const std::string& filename)
+{
+	return graphics.addModelAsync(filename);
+}
+
+StreamedModel& Application::addStreamedModel(const std::string& filename)
+{
+	return graphics.addStreamedModel(filename);
+}
+
+void Application::toggleInputRecording()
+{
+	if (m_replay.isRecording())
+	{
+		m_replay.stopRecording();
+	}
+	else if (!m_replay.isPlaying())
+	{
+		recordInput("input.onyxrec");
+	}
+}
+
+bool Application::recordInput(const std::string& filename)
+{
+	return m_replay.startRecording(filename, graphics.getCamera(), timePerFrame);
+}
+
+bool Application::replayInput(const std::string& filename)
+{
+	if (!m_replay.startPlayback(filename, graphics.getCamera(), timePerFrame))
+	{
+		return false;
+	}
+
+	graphics.storePreviousState();
+
+	return true;
+}
+
+void Application::toggleProfilerCapture()
+{
+	if (Profiler::isCapturing())
+	{
+		Profiler::endCapture();
+		Profiler::exportChromeTrace("trace.json");
 	}
+	else
+	{
+		std::cout << "\nProfiler capture started, press F12 again to stop" << std::endl;
+
+		Profiler::beginCapture();
+	}
+}
+
+void Application::publishSnapshot()
+{
+	PROFILE_SCOPE("Publish snapshot");
+
+	SceneSnapshot& snapshot = m_snapshots.back();
+
+	graphics.buildSnapshot(snapshot);
+
+	snapshot.time = m_clock.getElapsedTime();
+	snapshot.interpolation = pacer.getInterpolation();
+
+	m_snapshots.publish();
 }
 
-void Application::render()
+void Application::render(const SceneSnapshot& snapshot, float interpolation)
 {	
-	// Clear the depth buffer
-	glClearColor(0.2f, 0.2f, 0.2f, 1.0f);
-	glClear(GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT);
+	PROFILE_SCOPE("Render");
+
+	{
+		GPU_PROFILE_SCOPE("Render");
+
+		// Clear the depth buffer
+		glClearColor(0.2f, 0.2f, 0.2f, 1.0f);
+		glClear(GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT);
+
+		graphics.render(snapshot, interpolation);
+	}
 
-	graphics.render();
+	PROFILE_SCOPE("Display");
 
 	window.display();
 }
 
-void Application::run()
+void Application::renderLoop()
 {
-	// Create a clock for measuring the time elapsed
-	sf::Clock clock;
-	sf::Time timeSinceLastUpdate = sf::Time::Zero;
+	PROFILE_THREAD("Render");
+
+	window.setActive(true);
 
-	// Start loop
 	while (m_isOpen)
 	{
-		sf::Time dt;
-		dt = clock.restart();
-		timeSinceLastUpdate += dt;
+		PROFILE_SCOPE("Frame");
+
+		renderPacer.beginFrame();
 
-		while (timeSinceLastUpdate > timePerFrame)
+		m_snapshots.acquire();
+
+		const SceneSnapshot& snapshot = m_snapshots.front();
+
+		// Nothing to draw until the first update has been published
+		if (snapshot.sequence > 0)
 		{
-			timeSinceLastUpdate -= timePerFrame;
+			// Carry on blending towards the current pose for however long the
+			// snapshot has been waiting, frames between updates still move
+			const float elapsed = (m_clock.getElapsedTime() - snapshot.time).asSeconds() / timePerFrame.asSeconds();
+
+			GpuProfiler::beginFrame();
 
-			getInput();
+			render(snapshot, std::min(snapshot.interpolation + elapsed, 1.0f));
 
-			graphics.update(timePerFrame);
+			{
+				PROFILE_SCOPE("Capture");
+
+				capture.writeFrame();
+			}
+
+			GpuProfiler::endFrame();
 		}
 
-		render();
+		PROFILE_SCOPE("Frame pacing");
 
-		capture.writeFrame();
+		renderPacer.endFrame();
 	}
 
+	// Everything on the GPU goes with the thread that owns the context
 	capture.close();
 
+	GpuProfiler::shutdown();
+
+	MeshPool::instance().release();
+
+	window.setActive(false);
+}
+
+void Application::run()
+{
+	// Hand the context over to the render thread, the window's events still
+	// have to be polled on the thread that created it
+	window.setActive(false);
+
+	std::thread renderThread(&Application::renderLoop, this);
+
+	while (m_isOpen)
+	{
+		{
+			PROFILE_SCOPE("Frame");
+
+			pacer.beginFrame();
+
+			while (pacer.update())
+			{
+				graphics.storePreviousState();
+
+				getInput();
+
+				PROFILE_SCOPE("Update");
+
+				graphics.update(m_input, timePerFrame);
+			}
+
+			publishSnapshot();
+
+			PROFILE_SCOPE("Frame pacing");
+
+			pacer.endFrame();
+		}
+
+		Profiler::flush();
+	}
+
+	renderThread.join();
+
+	JobSystem::shutdown();
+
+	if (Profiler::isCapturing())
+	{
+		toggleProfilerCapture();
+	}
+
+	m_replay.stopRecording();
+	m_replay.stopPlayback();
+
+	std::cout << "\nRender thread:";
+	renderPacer.printStatistics();
+
+	std::cout << "\nUpdate thread:";
+	pacer.printStatistics();
+
+	MeshCache::instance().getStatistics().print();
+
 	window.close();
 }
\ No newline at end of file
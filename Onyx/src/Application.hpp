@@ -3,10 +3,21 @@
 #include "GL\glew.h"
 
 #include "GraphicSystem.hpp"
+#include "FramePacer.hpp"
 #include "rendering\Capture.hpp"
+#include "input\InputReplay.hpp"
+#include "input\InputState.hpp"
+#include "SceneSnapshot.hpp"
 
 #include "SFML\Window\Window.hpp"
+#include "SFML\System\Clock.hpp"
 
+#include <atomic>
+
+// Updates and renders on separate threads. The main thread polls the window,
+// runs the fixed timestep updates and publishes a snapshot of the scene after
+// each batch of them. The render thread owns the GL context and draws the latest
+// snapshot, so a slow swap or readback no longer holds up input and updates
 class Application
 {
 public:
@@ -15,6 +26,18 @@ public:
 
 	void run();
 
+	// Record every update tick's input so the session can be replayed later
+	bool recordInput(const std::string& filename);
+
+	// Drive the application from a recorded session instead of live input,
+	// closing once the recording ends
+	bool replayInput(const std::string& filename);
+
+	// Loads in the background, the model shows as a box until it's ready
+	Model& addModel(const std::string& filename);
+
+	StreamedModel& addStreamedModel(const std::string& filename);
+
 	void close()
 	{
 		m_isOpen = false;
@@ -22,12 +45,28 @@ public:
 
 private:
 
-	bool m_isOpen;
+	std::atomic<bool> m_isOpen;
 
 	const sf::Time timePerFrame = sf::seconds(1.0f / 60.0f);
 
 	void getInput();
-	void render();
+	void publishSnapshot();
+	void renderLoop();
+	void render(const SceneSnapshot& snapshot, float interpolation);
+	void toggleProfilerCapture();
+	void toggleInputRecording();
+
+	FramePacer pacer;				///< Paces the updates on the main thread
+
+	FramePacer renderPacer;			///< Limits the frame rate on the render thread
+
+	sf::Clock m_clock;				///< Shared by both threads to time snapshots
+
+	SnapshotBuffer m_snapshots;
+
+	InputReplay m_replay;
+
+	InputState m_input;
 
 	Capture capture;
 
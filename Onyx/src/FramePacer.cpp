@@ -0,0 +1,183 @@
+#include "FramePacer.hpp"
+
+#include "SFML\System\Sleep.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <cmath>
+
+namespace
+{
+	float percentile(const std::vector<float>& sorted, float p)
+	{
+		if (sorted.empty())
+		{
+			return 0.0f;
+		}
+
+		std::size_t index = static_cast<std::size_t>(std::ceil(p * sorted.size()));
+
+		return sorted[std::min(std::max(index, std::size_t(1)), sorted.size()) - 1];
+	}
+}
+
+FramePacer::FramePacer(sf::Time timePerUpdate)
+	:
+	m_timePerUpdate(timePerUpdate),
+	m_timePerFrame(sf::Time::Zero),
+	m_spinThreshold(sf::milliseconds(2)),
+	m_reportInterval(sf::seconds(10.0f)),
+	m_accumulator(sf::Time::Zero),
+	m_frameStart(sf::Time::Zero),
+	m_lastReport(sf::Time::Zero),
+	m_maxUpdateSteps(5),
+	m_updateSteps(0),
+	m_droppedUpdates(0)
+{
+}
+
+void FramePacer::setFrameRateLimit(unsigned int limit)
+{
+	m_timePerFrame = (limit > 0) ? sf::seconds(1.0f / limit) : sf::Time::Zero;
+}
+
+void FramePacer::setSpinThreshold(sf::Time threshold)
+{
+	m_spinThreshold = threshold;
+}
+
+void FramePacer::setMaxUpdateSteps(unsigned int steps)
+{
+	m_maxUpdateSteps = std::max(steps, 1u);
+}
+
+void FramePacer::setReportInterval(sf::Time interval)
+{
+	m_reportInterval = interval;
+}
+
+void FramePacer::beginFrame()
+{
+	sf::Time now = m_clock.getElapsedTime();
+	sf::Time dt = now - m_frameStart;
+
+	// The first frame has no predecessor to measure against
+	if (m_frameStart != sf::Time::Zero)
+	{
+		m_frameTimes.push_back(dt.asSeconds() * 1000.0f);
+		m_accumulator += dt;
+	}
+
+	m_frameStart = now;
+	m_updateSteps = 0;
+}
+
+bool FramePacer::update()
+{
+	if (m_accumulator < m_timePerUpdate)
+	{
+		return false;
+	}
+
+	if (m_updateSteps >= m_maxUpdateSteps)
+	{
+		// We've fallen too far behind (breakpoint, window drag, long load...)
+		// so drop the backlog rather than spiral trying to catch up
+		m_droppedUpdates += static_cast<unsigned int>(m_accumulator / m_timePerUpdate);
+		m_accumulator %= m_timePerUpdate;
+
+		return false;
+	}
+
+	m_accumulator -= m_timePerUpdate;
+	m_updateSteps++;
+
+	return true;
+}
+
+float FramePacer::getInterpolation() const
+{
+	return m_accumulator / m_timePerUpdate;
+}
+
+void FramePacer::endFrame()
+{
+	if (m_timePerFrame != sf::Time::Zero)
+	{
+		wait(m_frameStart, m_timePerFrame);
+	}
+
+	if (m_reportInterval != sf::Time::Zero && m_clock.getElapsedTime() - m_lastReport >= m_reportInterval)
+	{
+		printStatistics();
+
+		m_frameTimes.clear();
+		m_droppedUpdates = 0;
+		m_lastReport = m_clock.getElapsedTime();
+	}
+}
+
+void FramePacer::wait(sf::Time frameStart, sf::Time target)
+{
+	sf::Time remaining = target - (m_clock.getElapsedTime() - frameStart);
+
+	// Sleep for the bulk of the wait, the OS scheduler is too coarse to hit the
+	// deadline exactly so the last stretch is spun out
+	if (remaining > m_spinThreshold)
+	{
+		sf::sleep(remaining - m_spinThreshold);
+	}
+
+	while (m_clock.getElapsedTime() - frameStart < target)
+	{
+	}
+}
+
+FrameStatistics computeFrameStatistics(std::vector<float> sorted)
+{
+	FrameStatistics stats;
+
+	std::sort(sorted.begin(), sorted.end());
+
+	stats.frames = static_cast<unsigned int>(sorted.size());
+
+	if (!sorted.empty())
+	{
+		float total = 0.0f;
+
+		for (float t : sorted)
+		{
+			total += t;
+		}
+
+		stats.mean = total / sorted.size();
+		stats.p95 = percentile(sorted, 0.95f);
+		stats.p99 = percentile(sorted, 0.99f);
+		stats.max = sorted.back();
+	}
+
+	return stats;
+}
+
+FrameStatistics FramePacer::getStatistics() const
+{
+	FrameStatistics stats = computeFrameStatistics(m_frameTimes);
+	stats.droppedUpdates = m_droppedUpdates;
+
+	return stats;
+}
+
+void FramePacer::printStatistics() const
+{
+	FrameStatistics stats = getStatistics();
+
+	std::cout << "\nFrame time over " << stats.frames << " frames: mean " << stats.mean
+		<< "ms, p95 " << stats.p95 << "ms, p99 " << stats.p99 << "ms, max " << stats.max << "ms";
+
+	if (stats.droppedUpdates > 0)
+	{
+		std::cout << " (" << stats.droppedUpdates << " updates dropped)";
+	}
+
+	std::cout << std::endl;
+}
\ No newline at end of file
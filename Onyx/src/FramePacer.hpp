@@ -0,0 +1,73 @@
+#pragma once
+
+#include "SFML\System\Clock.hpp"
+#include "SFML\System\Time.hpp"
+
+#include <vector>
+
+struct FrameStatistics
+{
+	unsigned int frames = 0;          ///< Number of frames sampled
+	unsigned int droppedUpdates = 0;  ///< Update steps discarded by the catch-up cap
+	float        mean = 0.0f;         ///< Mean frame time in milliseconds
+	float        p95 = 0.0f;          ///< 95th percentile frame time in milliseconds
+	float        p99 = 0.0f;          ///< 99th percentile frame time in milliseconds
+	float        max = 0.0f;          ///< Worst frame time in milliseconds
+};
+
+// Summarise a set of frame times given in milliseconds
+FrameStatistics computeFrameStatistics(std::vector<float> frameTimes);
+
+class FramePacer
+{
+public:
+
+	FramePacer(sf::Time timePerUpdate);
+
+	// 0 disables the limiter and renders unthrottled
+	void setFrameRateLimit(unsigned int limit);
+
+	// How much of the wait is spent spinning instead of sleeping
+	void setSpinThreshold(sf::Time threshold);
+
+	void setMaxUpdateSteps(unsigned int steps);
+
+	// sf::Time::Zero disables the periodic report
+	void setReportInterval(sf::Time interval);
+
+	void beginFrame();
+
+	// Returns true while there is a whole fixed timestep left to simulate this frame
+	bool update();
+
+	// Fraction of a timestep that has elapsed since the last update, used to blend
+	// between the previous and current update states when rendering
+	float getInterpolation() const;
+
+	void endFrame();
+
+	FrameStatistics getStatistics() const;
+
+	void printStatistics() const;
+
+private:
+
+	void wait(sf::Time frameStart, sf::Time target);
+
+	sf::Clock m_clock;
+
+	sf::Time m_timePerUpdate;
+	sf::Time m_timePerFrame;
+	sf::Time m_spinThreshold;
+	sf::Time m_reportInterval;
+
+	sf::Time m_accumulator;
+	sf::Time m_frameStart;
+	sf::Time m_lastReport;
+
+	unsigned int m_maxUpdateSteps;
+	unsigned int m_updateSteps;
+	unsigned int m_droppedUpdates;
+
+	std::vector<float> m_frameTimes;
+};
\ No newline at end of file
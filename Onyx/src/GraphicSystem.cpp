@@ -2,10 +2,49 @@
 
 #include "SFML\Window\Window.hpp"
 
+#include "profiling\Profiler.hpp"
+
+#include "math\Frustum.hpp"
+
+#include "jobs\JobSystem.hpp"
+
+#include "rendering\MeshCache.hpp"
+
+#include <algorithm>
+
+namespace
+{
+	const std::size_t modelsPerJob = 64;
+}
+
 void GraphicSystem::init(sf::Window* window)
 {
 	this->window = window;
 
+	viewportWidth = appliedViewportWidth = window->getSize().x;
+	viewportHeight = appliedViewportHeight = window->getSize().y;
+
+	camera.init(window);
+
+	setup();
+}
+
+void GraphicSystem::init(unsigned int width, unsigned int height)
+{
+	this->window = nullptr;
+
+	viewportWidth = appliedViewportWidth = width;
+	viewportHeight = appliedViewportHeight = height;
+
+	camera.init(width, height);
+
+	setup();
+}
+
+void GraphicSystem::setup()
+{
+	PROFILE_FUNCTION();
+
 	// Enable Z-buffer read and write
 	glEnable(GL_DEPTH_TEST);
 	glDepthFunc(GL_LEQUAL); // for wireframe rendering
@@ -15,20 +54,354 @@ void GraphicSystem::init(sf::Window* window)
 
 	std::cout << "\nLoading Shaders..." << std::endl;
 
-	if (!modelShader.loadFromFile("./res/shaders/model.vert", "./res/shaders/model.frag"))
+	if (!modelShaders.loadFromFile("./res/shaders/model.vert", "./res/shaders/model.frag"))
 	{
 
 	}
 
-	camera.init(window);
 	camera.setPosition(0.5f, 0.75f, 1.6f);
 	camera.rotate(Vector3f::yAxis(), degrees(180));
 	camera.rotate(Vector3f::xAxis(), degrees(-20));
 
-	ground.create();
+	{
+		PROFILE_SCOPE("Ground::create");
+
+		ground.create();
+	}
+
+	placeholder = Mesh::create();
+	placeholder->setPrimitiveType(GL_LINES);
+
+	for (int i = 0; i < 8; ++i)
+	{
+		placeholder->addVertex(Vertex(Vector3f(float(i & 1), float((i >> 1) & 1), float((i >> 2) & 1)), Vector3f(0.0f, 1.0f, 0.0f)));
+	}
+
+	// Each edge joins two corners that differ in one bit
+	for (GLuint i = 0; i < 8; ++i)
+	{
+		for (GLuint bit = 1; bit < 8; bit <<= 1)
+		{
+			if (!(i & bit))
+			{
+				placeholder->addIndex(i);
+				placeholder->addIndex(i | bit);
+			}
+		}
+	}
+
+	placeholder->complete();
+}
+
+void GraphicSystem::update(const InputState& input, const sf::Time& dt)
+{
+	camera.Update(input, dt);
+
+	for (std::size_t i = 0; i < models.size(); ++i)
+	{
+		Model& model = models[i];
+
+		if (model.isLoading() && model.finishLoading() && model.getMesh())
+		{
+			modelBounds[i] = model.getPlaceholderBounds();
+
+			upload(model.getMesh());
+		}
+	}
+
+	std::vector<Mesh::Ptr> uploads;
+	std::vector<Mesh::Ptr> releases;
+
+	for (auto& streamed : streamedModels)
+	{
+		streamed->update(camera.getPosition(), uploads, releases);
+	}
+
+	for (auto& mesh : uploads)
+	{
+		upload(std::move(mesh));
+	}
+
+	for (auto& mesh : releases)
+	{
+		release(std::move(mesh));
+	}
+}
+
+void GraphicSystem::render(float interpolation)
+{
+	buildSnapshot(snapshot);
+
+	render(snapshot, interpolation);
+}
+
+void GraphicSystem::buildSnapshot(SceneSnapshot& snapshot)
+{
+	PROFILE_FUNCTION();
+
+	snapshot.sequence = ++snapshotSequence;
+
+	snapshot.camera = camera;
+
+	snapshot.viewportWidth = viewportWidth;
+	snapshot.viewportHeight = viewportHeight;
+
+	snapshot.flatShading = flatShading;
+	snapshot.indirectDrawing = indirectDrawing;
+	snapshot.clusterCulling = clusterCulling;
+
+	// The renderer blends between the previous and current pose, so keep
+	// anything in view at either end
+	Camera pose = camera;
+
+	pose.setInterpolation(0.0f);
+	const Matrix4f previousViewProjection = pose.getViewProjection();
+
+	pose.setInterpolation(1.0f);
+	const Matrix4f currentViewProjection = pose.getViewProjection();
+
+	// Culled in model space against each model's local bounds
+	visible.assign(models.size(), 0);
+
+	JobSystem::parallelFor(0, models.size(), modelsPerJob, [&](std::size_t first, std::size_t last)
+	{
+		for (std::size_t i = first; i < last; ++i)
+		{
+			const Model& model = models[i];
+
+			visible[i] = (model.getMesh() || model.isLoading()) &&
+				(Frustumf(currentViewProjection * model.getTransform()).intersects(modelBounds[i]) ||
+				 Frustumf(previousViewProjection * model.getTransform()).intersects(modelBounds[i]));
+		}
+	});
+
+	snapshot.models.clear();
+
+	for (std::size_t i = 0; i < models.size(); ++i)
+	{
+		if (visible[i])
+		{
+			snapshot.models.push_back(models[i]);
+		}
+	}
+
+	// Only the cells near the camera are loaded, few enough to cull here
+	streamedCells.clear();
+	streamedBounds.clear();
+
+	for (auto& streamed : streamedModels)
+	{
+		streamed->getModels(streamedCells, streamedBounds);
+	}
+
+	for (std::size_t i = 0; i < streamedCells.size(); ++i)
+	{
+		const Model& cell = streamedCells[i];
+
+		if (Frustumf(currentViewProjection * cell.getTransform()).intersects(streamedBounds[i]) ||
+			Frustumf(previousViewProjection * cell.getTransform()).intersects(streamedBounds[i]))
+		{
+			snapshot.models.push_back(cell);
+		}
+	}
+}
+
+void GraphicSystem::render(const SceneSnapshot& snapshot, float interpolation)
+{
+	PROFILE_FUNCTION();
+
+	processUploads();
+	processReleases(snapshot.sequence);
+
+	if (snapshot.viewportWidth != appliedViewportWidth || snapshot.viewportHeight != appliedViewportHeight)
+	{
+		glViewport(0, 0, snapshot.viewportWidth, snapshot.viewportHeight);
+
+		appliedViewportWidth = snapshot.viewportWidth;
+		appliedViewportHeight = snapshot.viewportHeight;
+	}
+
+	// The snapshot stays untouched, only this frame's copy of the camera is moved
+	Camera frameCamera = snapshot.camera;
+	frameCamera.setInterpolation(interpolation);
+
+	ground.render(modelShaders, frameCamera);
+
+	const unsigned int features = snapshot.flatShading ? ShaderFeature::FlatShading : 0;
+
+	if (snapshot.indirectDrawing)
+	{
+		indirect.setClusterCulling(snapshot.clusterCulling);
+		indirect.render(snapshot.models, modelShaders, frameCamera, features);
+	}
+	else
+	{
+		for (auto& model : snapshot.models)
+		{
+			model.render(modelShaders, frameCamera, false, features);
+		}
+	}
+
+	for (auto& model : snapshot.models)
+	{
+		Mesh::Ptr mesh = model.getMesh();
+
+		if (model.isLoading() || (mesh && !mesh->isUploaded()))
+		{
+			renderPlaceholder(model, frameCamera);
+		}
+	}
+}
+
+void GraphicSystem::renderPlaceholder(const Model& model, Camera& camera)
+{
+	const AABBf& bounds = model.getPlaceholderBounds();
+
+	const Matrix4f transform = model.getTransform() *
+		Matrix4f().InitTranslation(bounds.min) *
+		Matrix4f().InitScale(bounds.max - bounds.min);
+
+	Shader& shader = modelShaders.get(0);
+
+	shader.setUniform("objectColour", model.getColour());
+	shader.setUniform("lightColour", 1.0f, 1.0f, 1.0f);
+	shader.setUniform("lightPos", 0.5f, 1.1f, 0.8f);
+	shader.setUniform("viewPos", camera.getRenderPosition());
+
+	shader.setUniform("modelViewMatrix", transform);
+	shader.setUniform("modelViewProjectionMatrix", camera.getViewProjection() * transform);
+	shader.setUniform("normalMatrix", model.getInverseTransform().Transpose());
+
+	shader.bind();
+
+	placeholder->draw(false);
+}
+
+void GraphicSystem::upload(Mesh::Ptr mesh)
+{
+	std::lock_guard<std::mutex> lock(uploadMutex);
+
+	pendingUploads.push_back(std::move(mesh));
+}
+
+void GraphicSystem::release(Mesh::Ptr mesh)
+{
+	std::lock_guard<std::mutex> lock(releaseMutex);
+
+	pendingReleases.emplace_back(snapshotSequence, std::move(mesh));
+}
+
+void GraphicSystem::setUploadBudget(std::size_t bytes)
+{
+	std::lock_guard<std::mutex> lock(uploadMutex);
+
+	uploadBudget = bytes;
+}
+
+void GraphicSystem::processUploads()
+{
+	std::vector<Mesh::Ptr> uploads;
+
+	{
+		std::lock_guard<std::mutex> lock(uploadMutex);
+
+		std::size_t bytes = 0;
+
+		while (!pendingUploads.empty())
+		{
+			const Mesh::Ptr& mesh = pendingUploads.front();
+
+			const std::size_t size = mesh->getSize() * sizeof(Vertex) + mesh->getIndexCount() * sizeof(GLuint);
+
+			if (!uploads.empty() && bytes + size > uploadBudget)
+			{
+				break;
+			}
+
+			bytes += size;
+
+			uploads.push_back(mesh);
+			pendingUploads.pop_front();
+		}
+	}
+
+	if (uploads.empty())
+	{
+		return;
+	}
+
+	PROFILE_SCOPE("Upload meshes");
+
+	for (auto& mesh : uploads)
+	{
+		// Models loaded from the same file share a mesh, it may already be done
+		if (!mesh->isUploaded())
+		{
+			mesh->complete();
+		}
+	}
+}
+
+void GraphicSystem::processReleases(uint64_t sequence)
+{
+	std::vector<Mesh::Ptr> released;
+
+	{
+		std::lock_guard<std::mutex> lock(releaseMutex);
+
+		// A snapshot the render thread skipped can still refer to the mesh until
+		// the update thread writes over it, which has happened once two newer
+		// snapshots have been built
+		auto it = std::partition(pendingReleases.begin(), pendingReleases.end(),
+			[sequence](const std::pair<uint64_t, Mesh::Ptr>& release) { return release.first + 2 > sequence; });
+
+		for (auto i = it; i != pendingReleases.end(); ++i)
+		{
+			released.push_back(std::move(i->second));
+		}
+
+		pendingReleases.erase(it, pendingReleases.end());
+	}
+
+	// Destroyed here, outside the lock
+	released.clear();
+
+	// Meshes nothing uses any more may have to go to stay within budget
+	MeshCache::instance().trim();
 }
 
-void GraphicSystem::render()
+Model& GraphicSystem::addModel(const std::string& filename)
 {
-	ground.render(modelShader, camera);
+	models.emplace_back(filename);
+
+	modelBounds.push_back(models.back().getMesh() ? models.back().getLocalBounds() : AABBf());
+
+	return models.back();
+}
+
+Model& GraphicSystem::addModel(Mesh::Ptr mesh)
+{
+	models.emplace_back(mesh);
+
+	modelBounds.push_back(models.back().getLocalBounds());
+
+	return models.back();
+}
+
+StreamedModel& GraphicSystem::addStreamedModel(const std::string& filename)
+{
+	streamedModels.emplace_back(new StreamedModel());
+	streamedModels.back()->open(filename);
+
+	return *streamedModels.back();
+}
+
+Model& GraphicSystem::addModelAsync(const std::string& filename)
+{
+	models.emplace_back();
+	models.back().loadFromFileAsync(filename);
+
+	modelBounds.push_back(models.back().getPlaceholderBounds());
+
+	return models.back();
 }
\ No newline at end of file
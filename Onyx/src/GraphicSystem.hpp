@@ -3,14 +3,26 @@
 #include "GL\glew.h"
 
 #include "rendering\Transform.hpp"
-#include "rendering\Shader.hpp"
+#include "rendering\ShaderVariants.hpp"
 #include "rendering\Camera.hpp"
 #include "rendering\Model.hpp"
+#include "rendering\StreamedModel.hpp"
+#include "rendering\IndirectRenderer.hpp"
 #include "rendering\Ground.hpp"
 #include "rendering\Sphere.hpp"
 
+#include "SceneSnapshot.hpp"
+
 #include "SFML\Window\Event.hpp"
 
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
 namespace sf
 {
 	class Window;
@@ -22,31 +34,158 @@ public:
 
 	void init(sf::Window* window);
 
-	void render();
+	// Headless initialisation for offscreen rendering
+	void init(unsigned int width, unsigned int height);
+
+	// Snapshot the scene and draw it straight away, for when updating and
+	// rendering share a thread
+	void render(float interpolation = 1.0f);
+
+	// The scene is split between two threads. The update thread owns the camera,
+	// the models and the settings below, and copies what a frame needs into a
+	// snapshot. The render thread owns the GL context and everything on the GPU:
+	// the shaders, the ground, the indirect renderer and every uploaded mesh
+
+	// Update thread: copy the camera, the settings and the models that may be
+	// visible between the last two updates into the snapshot
+	void buildSnapshot(SceneSnapshot& snapshot);
+
+	// Render thread: finish any pending uploads and releases then draw the snapshot
+	void render(const SceneSnapshot& snapshot, float interpolation);
+
+	// Any thread: queue a mesh to be completed on the render thread. Models
+	// using it are drawn as a placeholder until it's uploaded
+	void upload(Mesh::Ptr mesh);
+
+	// Most vertex and index data uploaded per frame, so a burst of loads is
+	// spread over several frames. A mesh bigger than this gets a frame to itself
+	void setUploadBudget(std::size_t bytes);
+
+	// Update thread: hand over a mesh that's been removed from the scene. The
+	// render thread keeps it until no snapshot can still refer to it, so it's
+	// never destroyed on the update thread
+	void release(Mesh::Ptr mesh);
 
 	void handleEvent(const sf::Event& event, const sf::Time& dt)
 	{
 		camera.handleEvent(event, dt);
 
-		// Adjust the viewport when the window is resized
+		// Adjust the viewport when the window is resized, applied when rendering
 		if (event.type == sf::Event::Resized)
 		{
-			glViewport(0, 0, event.size.width, event.size.height);
+			viewportWidth = event.size.width;
+			viewportHeight = event.size.height;
+		}
+		// F key: toggle flat shading
+		if ((event.type == sf::Event::KeyPressed) && (event.key.code == sf::Keyboard::F))
+		{
+			flatShading = !flatShading;
+		}
+		// I key: toggle multi-draw indirect submission
+		if ((event.type == sf::Event::KeyPressed) && (event.key.code == sf::Keyboard::I))
+		{
+			indirectDrawing = !indirectDrawing;
 		}
+		// C key: toggle cluster culling on the indirect path
+		if ((event.type == sf::Event::KeyPressed) && (event.key.code == sf::Keyboard::C))
+		{
+			clusterCulling = !clusterCulling;
+		}
+	}
+
+	// Loads and uploads the model immediately, so this has to be called on the
+	// thread with the GL context before rendering starts
+	Model& addModel(const std::string& filename);
+
+	// Adds a model drawing a mesh that's already been completed, e.g. one that's
+	// generated rather than loaded. Same thread as addModel(filename)
+	Model& addModel(Mesh::Ptr mesh);
+
+	// Update thread: imports the model on the job system, update() picks it up
+	// when it's done and queues it for upload
+	Model& addModelAsync(const std::string& filename);
+
+	// Update thread: stream a binary STL too big to load at once, only the
+	// parts near the camera are loaded. The first time a file is used it has
+	// to be partitioned, which is done on the job system
+	StreamedModel& addStreamedModel(const std::string& filename);
+
+	// Submit all pooled models with one multi-draw instead of a draw each
+	void setIndirectDrawing(bool indirect)
+	{
+		indirectDrawing = indirect;
+	}
+
+	const std::vector<Model>& getModels() const
+	{
+		return models;
 	}
 
-	void update(const sf::Time& dt)
+	Camera& getCamera()
 	{
-		camera.Update(dt);
+		return camera;
 	}
 
+	void storePreviousState()
+	{
+		camera.storePreviousState();
+	}
+
+	void update(const InputState& input, const sf::Time& dt);
+
 private:
 
+	void setup();
+
+	void processUploads();
+
+	void renderPlaceholder(const Model& model, Camera& camera);
+
+	void processReleases(uint64_t sequence);
+
 	sf::Window* window;
 
-	Shader modelShader;
+	ShaderVariants modelShaders;
+
+	bool flatShading = false;
+
+	IndirectRenderer indirect;
+
+	bool indirectDrawing = false;
+
+	bool clusterCulling = true;
+
+	unsigned int viewportWidth = 0;
+	unsigned int viewportHeight = 0;
+
+	unsigned int appliedViewportWidth = 0;		///< What the render thread last gave glViewport
+	unsigned int appliedViewportHeight = 0;
 
 	Camera camera;
 
 	Ground ground;
+
+	Mesh::Ptr placeholder;						///< Unit box drawn in place of models still loading
+
+	std::vector<Model> models;
+
+	std::vector<AABBf> modelBounds;				///< Local bounds of each model for culling
+
+	std::vector<char> visible;					///< Culling results, kept to reuse the memory
+
+	std::vector<std::unique_ptr<StreamedModel>> streamedModels;
+
+	std::vector<Model> streamedCells;			///< Loaded cells of the streamed models, refilled every snapshot
+	std::vector<AABBf> streamedBounds;
+
+	uint64_t snapshotSequence = 0;
+
+	SceneSnapshot snapshot;						///< Used when updating and rendering share a thread
+
+	std::mutex uploadMutex;
+	std::deque<Mesh::Ptr> pendingUploads;
+	std::size_t uploadBudget = 8 * 1024 * 1024;
+
+	std::mutex releaseMutex;
+	std::vector<std::pair<uint64_t, Mesh::Ptr>> pendingReleases;	///< Paired with the last snapshot that could refer to them
 };
\ No newline at end of file
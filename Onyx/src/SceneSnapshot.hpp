@@ -0,0 +1,107 @@
+#pragma once
+
+#include "rendering\Camera.hpp"
+#include "rendering\Model.hpp"
+
+#include "SFML\System\Time.hpp"
+
+#include <cstdint>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+// Everything the renderer needs to draw a frame, copied out of the scene at
+// the end of an update. Once published it isn't modified again, so the render
+// thread can draw it while the update thread works on the next one
+struct SceneSnapshot
+{
+	uint64_t sequence = 0;				///< Counts up with every snapshot built, 0 if it's empty
+
+	sf::Time time;						///< When it was published, for extrapolating the interpolation
+	float interpolation = 1.0f;			///< Blend between the camera's previous and current pose when published
+
+	Camera camera;
+
+	std::vector<Model> models;			///< Only the models that passed frustum culling
+
+	unsigned int viewportWidth = 0;
+	unsigned int viewportHeight = 0;
+
+	bool flatShading = false;
+	bool indirectDrawing = false;
+	bool clusterCulling = true;
+
+	// Drop the references to the models' meshes but keep the memory for reuse
+	void clear()
+	{
+		models.clear();
+	}
+};
+
+// Hands snapshots from the update thread to the render thread without either
+// waiting on the other. The update thread writes the back slot while the render
+// thread draws the front one, and the slot in between holds the latest
+// published snapshot the render thread hasn't picked up yet
+class SnapshotBuffer
+{
+public:
+
+	// Update thread: the slot to write the next snapshot into
+	SceneSnapshot& back()
+	{
+		return m_slots[m_back];
+	}
+
+	// Update thread: hand the back slot over, replacing any snapshot the render
+	// thread skipped
+	void publish()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		std::swap(m_back, m_pending);
+		m_fresh = true;
+	}
+
+	// Render thread: swap in the latest published snapshot, returns false if
+	// there hasn't been one since the last call
+	bool acquire()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			if (!m_fresh)
+			{
+				return false;
+			}
+		}
+
+		// The old front goes back to the update thread, drop its mesh references
+		// here so meshes are only ever destroyed on the render thread
+		m_slots[m_front].clear();
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		std::swap(m_front, m_pending);
+		m_fresh = false;
+
+		return true;
+	}
+
+	// Render thread: the snapshot to draw
+	const SceneSnapshot& front() const
+	{
+		return m_slots[m_front];
+	}
+
+private:
+
+	SceneSnapshot m_slots[3];
+
+	int m_back = 0;
+	int m_pending = 1;
+	int m_front = 2;
+
+	bool m_fresh = false;
+
+	std::mutex m_mutex;
+};
\ No newline at end of file
@@ -1,5 +1,8 @@
 #include "Utilities.hpp"
 
+#include <emmintrin.h>
+#include <intrin.h>
+
 #include <iostream>
 
 void Util::consoleWait()
@@ -32,4 +35,38 @@ std::vector<std::string> Util::split(const std::string& s, char delim)
 	}
 
 	return elems;
+}
+
+std::size_t Util::find(std::string_view text, char delim)
+{
+	const char* data = text.data();
+	const std::size_t size = text.size();
+
+	const __m128i pattern = _mm_set1_epi8(delim);
+
+	std::size_t i = 0;
+
+	for (; i + 16 <= size; i += 16)
+	{
+		const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+		const int matches = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, pattern));
+
+		if (matches != 0)
+		{
+			unsigned long first;
+			_BitScanForward(&first, static_cast<unsigned long>(matches));
+
+			return i + first;
+		}
+	}
+
+	for (; i < size; ++i)
+	{
+		if (data[i] == delim)
+		{
+			return i;
+		}
+	}
+
+	return size;
 }
\ No newline at end of file
@@ -1,5 +1,8 @@
 #pragma once
 
+#include <charconv>
+#include <string_view>
+#include <system_error>
 #include <vector>
 #include <string>
 #include <sstream>
@@ -17,4 +20,108 @@ namespace Util
 		stream << value;
 		return stream.str();
 	}
+
+	// The functions below are for parsing and writing in bulk, e.g. ASCII model
+	// files, and never allocate. Tokens are views into the text they came from,
+	// so the text has to outlive them
+
+	// Position of the first delim in text, or its size if there isn't one.
+	// Compares 16 characters at a time
+	std::size_t find(std::string_view text, char delim);
+
+	// Splits text on a delimiter, giving the same tokens as split() including
+	// the empty ones between adjacent delimiters, unless they're skipped
+	class Tokenizer
+	{
+	public:
+
+		Tokenizer(std::string_view text, char delim, bool skipEmpty = false) :
+			m_text(text),
+			m_position(0),
+			m_delim(delim),
+			m_skipEmpty(skipEmpty)
+		{}
+
+		// False once every token has been returned
+		bool next(std::string_view& token)
+		{
+			while (m_position <= m_text.size())
+			{
+				const std::string_view rest = m_text.substr(m_position);
+				const std::size_t end = find(rest, m_delim);
+
+				token = rest.substr(0, end);
+				m_position += end + 1;
+
+				if (!m_skipEmpty || !token.empty())
+				{
+					return true;
+				}
+			}
+
+			return false;
+		}
+
+		// What hasn't been tokenized yet
+		std::string_view remaining() const
+		{
+			return m_position <= m_text.size() ? m_text.substr(m_position) : std::string_view();
+		}
+
+	private:
+
+		std::string_view m_text;
+
+		std::size_t m_position;			///< Past the end once the last token has been returned
+
+		char m_delim;
+
+		bool m_skipEmpty;
+	};
+
+	// Calls function(token) with each token of text, see Tokenizer
+	template <class Function>
+	inline void forEachToken(std::string_view text, char delim, Function function, bool skipEmpty = false)
+	{
+		Tokenizer tokenizer(text, delim, skipEmpty);
+		std::string_view token;
+
+		while (tokenizer.next(token))
+		{
+			function(token);
+		}
+	}
+
+	// Parses the whole of text as a number, false if any of it isn't part of one.
+	// Floats are rounded correctly, unlike going through atof and a cast
+	template <class T>
+	inline bool fromChars(std::string_view text, T& value)
+	{
+		const char* last = text.data() + text.size();
+		const std::from_chars_result result = std::from_chars(text.data(), last, value);
+
+		return result.ec == std::errc() && result.ptr == last;
+	}
+
+	// Writes value into [first, last) and returns the end of it, or null if it
+	// didn't fit. Floats are written in the shortest form that reads back exactly
+	template <class T>
+	inline char* toChars(char* first, char* last, T value)
+	{
+		const std::to_chars_result result = std::to_chars(first, last, value);
+
+		return result.ec == std::errc() ? result.ptr : nullptr;
+	}
+
+	// Appends value to out, only allocating if out has to grow
+	template <class T>
+	inline void appendString(std::string& out, T value)
+	{
+		char buffer[32];
+
+		if (char* end = toChars(buffer, buffer + sizeof(buffer), value))
+		{
+			out.append(buffer, end);
+		}
+	}
 }
\ No newline at end of file
@@ -0,0 +1,776 @@
+#include "Benchmark.hpp"
+
+#include "Utilities.hpp"
+
+#include "profiling\Profiler.hpp"
+#include "profiling\GpuProfiler.hpp"
+
+#include "jobs\JobSystem.hpp"
+
+#include "math\MathHelper.hpp"
+
+#include "rendering\MeshCache.hpp"
+#include "rendering\MeshImporter.hpp"
+#include "rendering\MeshPool.hpp"
+
+#include <atomic>
+#include <thread>
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+
+namespace
+{
+	// The path is everything after a model's colour, it may contain spaces
+	std::string modelPath(const std::vector<std::string>& tokens)
+	{
+		std::string path = tokens[11];
+
+		for (std::size_t i = 12; i < tokens.size(); ++i)
+		{
+			path += " " + tokens[i];
+		}
+
+		return path;
+	}
+
+	sf::ContextSettings contextSettings()
+	{
+		sf::ContextSettings settings;
+		settings.majorVersion = 4;
+		settings.minorVersion = 5;
+		settings.depthBits = 24;
+		settings.attributeFlags = settings.Core;
+
+		return settings;
+	}
+
+	float toFloat(const std::string& s)
+	{
+		return static_cast<float>(std::atof(s.c_str()));
+	}
+
+	// Two whole periods across the grid each way, so the starting heights
+	// already reach the full amplitude and the bounds cover every frame
+	float waveHeight(float x, float z, float size, float amplitude, float time)
+	{
+		const float frequency = 2.0f * 2.0f * static_cast<float>(MATH_PI) / size;
+
+		return amplitude * std::sin(x * frequency + time) * std::cos(z * frequency + time);
+	}
+}
+
+Benchmark::Benchmark(unsigned int width, unsigned int height)
+	:
+	m_context(contextSettings(), width, height),
+	m_ready(false),
+	m_width(width),
+	m_height(height),
+	m_frames(600),
+	m_warmupFrames(30),
+	m_indirect(false),
+	m_compare(false),
+	m_jobScaling(false),
+	m_stringParsing(false)
+{
+	std::cout << "\nInitialising GLEW..." << std::endl;
+
+	m_context.setActive(true);
+
+	GLenum err = glewInit();
+	if (GLEW_OK != err)
+	{
+		std::cout << "Error: " << glewGetErrorString(err) << std::endl;
+		return;
+	}
+
+	std::cout << "\nRenderer: " << glGetString(GL_RENDERER) << " (" << glGetString(GL_VERSION) << ")" << std::endl;
+
+	if (!m_target.create(width, height))
+	{
+		return;
+	}
+
+	GpuProfiler::init();
+
+	m_graphics.init(width, height);
+
+	m_ready = true;
+}
+
+Benchmark::~Benchmark()
+{
+	// The context goes with the benchmark, long before the pool is destroyed
+	if (m_ready)
+	{
+		MeshPool::instance().release();
+	}
+}
+
+bool Benchmark::loadScene(const std::string& filename)
+{
+	// Meshes are uploaded as they're loaded, which needs the context
+	if (!m_ready)
+	{
+		return false;
+	}
+
+	std::ifstream file(filename.c_str());
+
+	if (!file)
+	{
+		std::cout << "Failed to open benchmark scene: " << filename << std::endl;
+		return false;
+	}
+
+	m_path.clear();
+
+	struct SceneLine
+	{
+		unsigned int number;
+		std::string text;
+		std::vector<std::string> tokens;
+	};
+
+	std::vector<SceneLine> lines;
+	std::vector<std::string> models;
+
+	std::string line;
+	unsigned int lineNumber = 0;
+
+	while (std::getline(file, line))
+	{
+		lineNumber++;
+
+		if (!line.empty() && line.back() == '\r')
+		{
+			line.pop_back();
+		}
+
+		std::vector<std::string> tokens;
+
+		for (auto& token : Util::split(line, ' '))
+		{
+			if (!token.empty())
+			{
+				tokens.push_back(token);
+			}
+		}
+
+		if (tokens.empty() || tokens[0][0] == '#')
+		{
+			continue;
+		}
+
+		if (tokens[0] == "model" && tokens.size() >= 12)
+		{
+			models.push_back(modelPath(tokens));
+		}
+
+		lines.push_back({ lineNumber, line, tokens });
+	}
+
+	// Import every model up front so the files load in parallel, the models
+	// added below then share the meshes
+	MeshImporter::Statistics statistics;
+	MeshImporter::importAll(models, &statistics);
+
+	statistics.print();
+
+	for (auto& sceneLine : lines)
+	{
+		if (!parseLine(sceneLine.tokens))
+		{
+			std::cout << filename << "(" << sceneLine.number << "): could not parse \"" << sceneLine.text << "\"" << std::endl;
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool Benchmark::parseLine(const std::vector<std::string>& tokens)
+{
+	const std::string& command = tokens[0];
+
+	if (command == "frames" && tokens.size() == 2)
+	{
+		m_frames = static_cast<unsigned int>(std::atoi(tokens[1].c_str()));
+	}
+	else if (command == "model" && tokens.size() >= 12)
+	{
+		Model& model = m_graphics.addModel(modelPath(tokens));
+		model.setPosition(toFloat(tokens[1]), toFloat(tokens[2]), toFloat(tokens[3]));
+		model.rotate(Vector3f::xAxis(), degrees(toFloat(tokens[4])));
+		model.rotate(Vector3f::yAxis(), degrees(toFloat(tokens[5])));
+		model.rotate(Vector3f::zAxis(), degrees(toFloat(tokens[6])));
+		model.setScale(toFloat(tokens[7]));
+		model.setColour(Vector3f(toFloat(tokens[8]), toFloat(tokens[9]), toFloat(tokens[10])));
+	}
+	else if (command == "wave" && tokens.size() == 10)
+	{
+		const int resolution = std::atoi(tokens[5].c_str());
+
+		if (resolution < 2 || toFloat(tokens[4]) <= 0.0f)
+		{
+			return false;
+		}
+
+		addWave(Vector3f(toFloat(tokens[1]), toFloat(tokens[2]), toFloat(tokens[3])),
+			toFloat(tokens[4]), static_cast<std::size_t>(resolution), toFloat(tokens[6]),
+			Vector3f(toFloat(tokens[7]), toFloat(tokens[8]), toFloat(tokens[9])));
+	}
+	else if (command == "camera" && tokens.size() == 7)
+	{
+		m_path.addKeyframe(toFloat(tokens[1]),
+			Vector3f(toFloat(tokens[2]), toFloat(tokens[3]), toFloat(tokens[4])),
+			toFloat(tokens[5]), toFloat(tokens[6]));
+	}
+	else
+	{
+		return false;
+	}
+
+	return true;
+}
+
+void Benchmark::addWave(const Vector3f& position, float size, std::size_t resolution, float amplitude, const Vector3f& colour)
+{
+	Mesh::Ptr mesh = Mesh::create();
+	mesh->setStreaming(true);
+
+	const float spacing = size / (resolution - 1);
+	const float half = size * 0.5f;
+
+	for (std::size_t z = 0; z < resolution; ++z)
+	{
+		for (std::size_t x = 0; x < resolution; ++x)
+		{
+			const float px = x * spacing - half;
+			const float pz = z * spacing - half;
+
+			mesh->addVertex(Vertex(Vector3f(px, waveHeight(px, pz, size, amplitude, 0.0f), pz), Vector3f(0.0f, 1.0f, 0.0f)));
+		}
+	}
+
+	// Two triangles a square, wound to face up
+	for (std::size_t z = 0; z + 1 < resolution; ++z)
+	{
+		for (std::size_t x = 0; x + 1 < resolution; ++x)
+		{
+			const GLuint corner = static_cast<GLuint>(z * resolution + x);
+			const GLuint across = corner + 1;
+			const GLuint below = corner + static_cast<GLuint>(resolution);
+
+			mesh->addIndex(corner);
+			mesh->addIndex(below);
+			mesh->addIndex(across);
+
+			mesh->addIndex(across);
+			mesh->addIndex(below);
+			mesh->addIndex(below + 1);
+		}
+	}
+
+	mesh->complete();
+	mesh->updateNormals();
+
+	Model& model = m_graphics.addModel(mesh);
+	model.setPosition(position.x, position.y, position.z);
+	model.setColour(colour);
+
+	m_waves.push_back({ mesh, resolution, size, amplitude });
+}
+
+void Benchmark::updateWaves(float time)
+{
+	PROFILE_FUNCTION();
+
+	for (auto& wave : m_waves)
+	{
+		Mesh& mesh = *wave.mesh;
+
+		// Streaming meshes always keep their arrays, nothing can page them out
+		Vertex* vertices = &mesh[0];
+
+		JobSystem::parallelFor(0, mesh.getSize(), wave.resolution, [&](std::size_t first, std::size_t last)
+		{
+			for (std::size_t i = first; i < last; ++i)
+			{
+				Vector3f& position = vertices[i].position;
+
+				position.y = waveHeight(position.x, position.z, wave.size, wave.amplitude, time);
+			}
+		});
+
+		// Recalculates the normals and streams the whole vertex array
+		mesh.updateNormals();
+	}
+}
+
+void Benchmark::setFrameCount(unsigned int frames)
+{
+	m_frames = frames;
+}
+
+void Benchmark::setTraceFile(const std::string& filename)
+{
+	m_traceFile = filename;
+}
+
+void Benchmark::setIndirectDrawing(bool indirect)
+{
+	m_indirect = indirect;
+}
+
+void Benchmark::setCompareDrawPaths(bool compare)
+{
+	m_compare = compare;
+}
+
+void Benchmark::setJobScaling(bool scaling)
+{
+	m_jobScaling = scaling;
+}
+
+void Benchmark::setStringParsing(bool parsing)
+{
+	m_stringParsing = parsing;
+}
+
+bool Benchmark::run()
+{
+	if (!m_ready)
+	{
+		return false;
+	}
+
+	const bool trace = !m_traceFile.empty();
+
+	if (m_jobScaling)
+	{
+		const bool passed = measureJobScaling();
+
+		GpuProfiler::shutdown();
+
+		return passed;
+	}
+
+	if (m_stringParsing)
+	{
+		const bool passed = measureStringParsing();
+
+		GpuProfiler::shutdown();
+
+		return passed;
+	}
+
+	if (m_compare)
+	{
+		// Only trace the second pass, by then both paths' shaders and buffers exist
+		const Result direct = measure(false, false);
+		const Result indirect = measure(true, trace);
+
+		printResult("Direct", direct);
+		printResult("Multi-draw indirect", indirect);
+
+		if (indirect.frames.mean > 0.0f)
+		{
+			std::cout << "\nIndirect speedup: " << direct.frames.mean / indirect.frames.mean << "x mean frame time" << std::endl;
+		}
+	}
+	else
+	{
+		printResult(m_indirect ? "Multi-draw indirect" : "Direct", measure(m_indirect, trace));
+	}
+
+	MeshCache::instance().getStatistics().print();
+
+	GpuProfiler::shutdown();
+
+	return true;
+}
+
+Benchmark::Result Benchmark::measure(bool indirect, bool trace)
+{
+	// Simulated time advances by a fixed step per frame, independent of how long
+	// the frame took, so the camera visits the same views on every machine
+	const float timestep = 1.0f / 60.0f;
+
+	std::vector<float> frameTimes;
+	frameTimes.reserve(m_frames);
+
+	Result result = {};
+
+	m_graphics.setIndirectDrawing(indirect);
+
+	m_target.bind();
+	glViewport(0, 0, m_width, m_height);
+
+	for (unsigned int i = 0; i < m_warmupFrames + m_frames; ++i)
+	{
+		const bool measured = (i >= m_warmupFrames);
+
+		if (i == m_warmupFrames && trace)
+		{
+			Profiler::beginCapture();
+		}
+
+		const float time = measured ? (i - m_warmupFrames) * timestep : 0.0f;
+
+		m_path.apply(m_graphics.getCamera(), time);
+
+		Mesh::resetStatistics();
+
+		const auto start = std::chrono::high_resolution_clock::now();
+
+		{
+			PROFILE_SCOPE("Frame");
+
+			GpuProfiler::beginFrame();
+
+			updateWaves(time);
+
+			{
+				GPU_PROFILE_SCOPE("Render");
+
+				glClearColor(0.2f, 0.2f, 0.2f, 1.0f);
+				glClear(GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT);
+
+				m_graphics.render();
+			}
+
+			GpuProfiler::endFrame();
+
+			// Without a swap nothing forces the frame to complete, so wait for it
+			// explicitly or we'd only be timing command submission
+			PROFILE_SCOPE("glFinish");
+
+			glFinish();
+		}
+
+		const auto end = std::chrono::high_resolution_clock::now();
+
+		Profiler::flush();
+
+		if (measured)
+		{
+			const double seconds = std::chrono::duration<double>(end - start).count();
+
+			frameTimes.push_back(static_cast<float>(seconds * 1000.0));
+			result.seconds += seconds;
+			result.drawCalls += Mesh::getDrawCalls();
+			result.meshes += Mesh::getMeshesDrawn();
+			result.primitives += Mesh::getPrimitiveCount();
+		}
+	}
+
+	m_target.unbind();
+
+	if (trace)
+	{
+		Profiler::endCapture();
+		Profiler::exportChromeTrace(m_traceFile);
+	}
+
+	result.frames = computeFrameStatistics(frameTimes);
+
+	return result;
+}
+
+void Benchmark::printResult(const std::string& label, const Result& result) const
+{
+	const FrameStatistics& stats = result.frames;
+
+	std::cout << "\n" << label << ": " << stats.frames << " frames at " << m_width << "x" << m_height << std::endl;
+	std::cout << "Frame time: mean " << stats.mean << "ms, p95 " << stats.p95 << "ms, p99 " << stats.p99 << "ms, max " << stats.max << "ms" << std::endl;
+
+	if (stats.frames > 0 && result.seconds > 0.0)
+	{
+		std::cout << "Draw calls per frame: " << result.drawCalls / stats.frames
+			<< ", meshes per frame: " << result.meshes / stats.frames
+			<< ", primitives per frame: " << result.primitives / stats.frames << std::endl;
+		std::cout << "Throughput: " << result.meshes / result.seconds << " meshes/s, "
+			<< result.primitives / result.seconds / 1.0e6 << " Mtris/s" << std::endl;
+	}
+}
+
+bool Benchmark::measureJobScaling()
+{
+	const unsigned int maxThreads = std::max(std::thread::hardware_concurrency(), 1u);
+	const unsigned int repeats = 10;
+
+	// Synthetic work, a sum of squares over a range big enough to split up
+	const std::size_t count = 1 << 24;
+	const std::size_t grain = 1 << 14;
+
+	bool passed = true;
+	double baseline = 0.0;
+
+	std::vector<AABBf> expectedBounds;
+	std::vector<float> expectedVolumes;
+	uint64_t expectedSum = 0;
+
+	for (unsigned int threads = 1; threads <= maxThreads; ++threads)
+	{
+		// One thread runs every job inline on this thread
+		JobSystem::shutdown();
+
+		if (threads > 1)
+		{
+			JobSystem::init(threads - 1);
+		}
+
+		std::vector<AABBf> bounds;
+		std::vector<float> volumes;
+		uint64_t sum = 0;
+
+		const auto start = std::chrono::high_resolution_clock::now();
+
+		for (unsigned int r = 0; r < repeats; ++r)
+		{
+			bounds.clear();
+			volumes.clear();
+
+			for (auto& model : m_graphics.getModels())
+			{
+				if (model.getMesh())
+				{
+					bounds.push_back(model.getMesh()->getLocalBounds());
+					volumes.push_back(model.getMesh()->getVolume(model.getTransform()));
+				}
+			}
+
+			std::vector<uint64_t> partial(JobSystem::chunkCount(count, grain), 0);
+
+			JobSystem::parallelFor(0, count, grain, [&](std::size_t first, std::size_t last)
+			{
+				uint64_t total = 0;
+
+				for (std::size_t i = first; i < last; ++i)
+				{
+					total += static_cast<uint64_t>(i) * i;
+				}
+
+				partial[first / grain] = total;
+			});
+
+			sum = 0;
+
+			for (auto p : partial)
+			{
+				sum += p;
+			}
+		}
+
+		const double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+		// Dependencies and continuations: a chain that has to run in order, and a
+		// fan out from one job to many that all have to finish before the last
+		std::vector<unsigned int> order;
+		std::mutex orderMutex;
+
+		JobSystem::Handle first = JobSystem::create([&]() { std::lock_guard<std::mutex> lock(orderMutex); order.push_back(0); });
+		JobSystem::Handle link = first;
+
+		for (unsigned int i = 1; i < 256; ++i)
+		{
+			link = JobSystem::then(link, [&, i]() { std::lock_guard<std::mutex> lock(orderMutex); order.push_back(i); });
+		}
+
+		std::atomic<unsigned int> fanned(0);
+		std::atomic<bool> joinedEarly(false);
+
+		JobSystem::Handle join = JobSystem::create([&]() { joinedEarly = (fanned.load() != 1024); });
+
+		for (unsigned int i = 0; i < 1024; ++i)
+		{
+			JobSystem::Handle job = JobSystem::create([&]() { fanned++; });
+
+			JobSystem::addDependency(job, link);
+			JobSystem::addDependency(join, job);
+			JobSystem::run(job);
+		}
+
+		JobSystem::run(join);
+		JobSystem::run(first);
+		JobSystem::wait(join);
+
+		bool inOrder = (order.size() == 256);
+
+		for (unsigned int i = 0; inOrder && i < order.size(); ++i)
+		{
+			inOrder = (order[i] == i);
+		}
+
+		if (threads == 1)
+		{
+			baseline = seconds;
+			expectedBounds = bounds;
+			expectedVolumes = volumes;
+			expectedSum = sum;
+		}
+
+		// Chunks are combined in order so the results should match exactly
+		bool matches = (sum == expectedSum) && (volumes == expectedVolumes) && (bounds.size() == expectedBounds.size());
+
+		for (std::size_t i = 0; matches && i < bounds.size(); ++i)
+		{
+			matches = (bounds[i].min == expectedBounds[i].min) && (bounds[i].max == expectedBounds[i].max);
+		}
+
+		std::cout << "\n" << threads << " thread" << (threads > 1 ? "s" : "") << ": " << seconds * 1000.0 / repeats << "ms per pass, "
+			<< baseline / seconds << "x speedup";
+
+		if (!matches)
+		{
+			std::cout << ", RESULTS DIFFER";
+		}
+		if (!inOrder || joinedEarly || fanned != 1024)
+		{
+			std::cout << ", DEPENDENCIES BROKEN";
+		}
+
+		std::cout << std::endl;
+
+		passed = passed && matches && inOrder && !joinedEarly && fanned == 1024;
+	}
+
+	JobSystem::shutdown();
+
+	return passed;
+}
+
+bool Benchmark::measureStringParsing()
+{
+	const std::size_t lineCount = 1 << 20;
+	const unsigned int repeats = 5;
+
+	// Vertex lines like an OBJ file's, with values spread over a few magnitudes
+	std::vector<float> values;
+	values.reserve(lineCount * 3);
+
+	uint32_t seed = 12345;
+
+	for (std::size_t i = 0; i < lineCount * 3; ++i)
+	{
+		seed = seed * 1664525u + 1013904223u;
+
+		values.push_back((static_cast<float>(seed >> 8) / 16777216.0f - 0.5f) * static_cast<float>(1 << (seed & 7)));
+	}
+
+	// Writing the text is timed too, toString() against appendString()
+	std::string text;
+	std::string charconvText;
+
+	double toStringSeconds = 0.0;
+	double appendSeconds = 0.0;
+
+	for (unsigned int r = 0; r < repeats; ++r)
+	{
+		text.clear();
+		charconvText.clear();
+
+		auto start = std::chrono::high_resolution_clock::now();
+
+		for (std::size_t i = 0; i < values.size(); i += 3)
+		{
+			text += "v " + Util::toString(values[i]) + " " + Util::toString(values[i + 1]) + " " + Util::toString(values[i + 2]) + "\n";
+		}
+
+		toStringSeconds += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+		start = std::chrono::high_resolution_clock::now();
+
+		for (std::size_t i = 0; i < values.size(); i += 3)
+		{
+			charconvText += "v ";
+			Util::appendString(charconvText, values[i]);
+			charconvText += ' ';
+			Util::appendString(charconvText, values[i + 1]);
+			charconvText += ' ';
+			Util::appendString(charconvText, values[i + 2]);
+			charconvText += '\n';
+		}
+
+		appendSeconds += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+
+	// Both ways of parsing read the shortest round trip text, so they should
+	// both get back exactly the values written
+	std::vector<float> splitValues;
+	std::vector<float> tokenValues;
+
+	double splitSeconds = 0.0;
+	double tokenSeconds = 0.0;
+
+	for (unsigned int r = 0; r < repeats; ++r)
+	{
+		splitValues.clear();
+		tokenValues.clear();
+
+		auto start = std::chrono::high_resolution_clock::now();
+
+		for (auto& line : Util::split(charconvText, '\n'))
+		{
+			const std::vector<std::string> tokens = Util::split(line, ' ');
+
+			if (tokens.size() == 4 && tokens[0] == "v")
+			{
+				for (std::size_t i = 1; i < 4; ++i)
+				{
+					splitValues.push_back(toFloat(tokens[i]));
+				}
+			}
+		}
+
+		splitSeconds += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+		start = std::chrono::high_resolution_clock::now();
+
+		Util::forEachToken(charconvText, '\n', [&tokenValues](std::string_view line)
+		{
+			Util::Tokenizer tokenizer(line, ' ', true);
+			std::string_view token;
+
+			if (!tokenizer.next(token) || token != "v")
+			{
+				return;
+			}
+
+			float value;
+
+			while (tokenizer.next(token) && Util::fromChars(token, value))
+			{
+				tokenValues.push_back(value);
+			}
+		});
+
+		tokenSeconds += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+
+	const double megabytes = charconvText.size() * double(repeats) / (1024.0 * 1024.0);
+
+	std::cout << "\n" << lineCount << " lines, " << charconvText.size() / (1024.0 * 1024.0) << "MB" << std::endl;
+	std::cout << "Util::toString:       " << toStringSeconds * 1000.0 / repeats << "ms per pass" << std::endl;
+	std::cout << "Util::appendString:   " << appendSeconds * 1000.0 / repeats << "ms per pass, "
+		<< toStringSeconds / appendSeconds << "x speedup" << std::endl;
+	std::cout << "Util::split + atof:   " << splitSeconds * 1000.0 / repeats << "ms per pass, "
+		<< megabytes / splitSeconds << " MB/s" << std::endl;
+	std::cout << "Tokenizer + fromChars: " << tokenSeconds * 1000.0 / repeats << "ms per pass, "
+		<< megabytes / tokenSeconds << " MB/s, " << splitSeconds / tokenSeconds << "x speedup" << std::endl;
+
+	const bool matches = (splitValues == values) && (tokenValues == values);
+
+	if (!matches)
+	{
+		std::cout << "RESULTS DIFFER" << std::endl;
+	}
+
+	return matches;
+}
\ No newline at end of file
@@ -0,0 +1,116 @@
+#pragma once
+
+#include "GL\glew.h"
+
+#include "GraphicSystem.hpp"
+#include "buffers\FBO.hpp"
+
+#include "CameraPath.hpp"
+#include "FramePacer.hpp"
+
+#include "SFML\Window\Context.hpp"
+
+#include <string>
+
+// Renders a scripted scene into an offscreen framebuffer with no window, so
+// render performance can be measured reproducibly on a build server
+class Benchmark
+{
+public:
+
+	Benchmark(unsigned int width, unsigned int height);
+
+	~Benchmark();
+
+	// Scene scripts are plain text, one command per line:
+	//   frames <count>
+	//   model <x> <y> <z> <rotX> <rotY> <rotZ> <scale> <r> <g> <b> <path>
+	//   camera <time> <x> <y> <z> <yaw> <pitch>
+	//   wave <x> <y> <z> <size> <resolution> <amplitude> <r> <g> <b>
+	// A wave is a square grid of resolution vertices a side whose heights and
+	// normals change every frame, drawn from a streaming mesh
+	// Fails straight away if the context or framebuffer couldn't be set up
+	bool loadScene(const std::string& filename);
+
+	// Overrides the frame count from the scene script
+	void setFrameCount(unsigned int frames);
+
+	// Capture a CPU + GPU profiler trace of the measured frames
+	void setTraceFile(const std::string& filename);
+
+	// Submit the models with one multi-draw indirect call instead of a draw each
+	void setIndirectDrawing(bool indirect);
+
+	// Measure the scene with both submission paths and compare them
+	void setCompareDrawPaths(bool compare);
+
+	// Instead of rendering, time mesh processing and a synthetic workload on
+	// the job system with 1 to N threads, checking every run gets the same results
+	void setJobScaling(bool scaling);
+
+	// Instead of rendering, time splitting and converting numbers in a
+	// synthetic OBJ-like text with Util::split() and Util::toString() against
+	// the tokenizer and the charconv helpers, checking both read the same values
+	void setStringParsing(bool parsing);
+
+	bool run();
+
+private:
+
+	struct Result
+	{
+		FrameStatistics frames;
+		double seconds;
+		std::size_t drawCalls;
+		std::size_t meshes;
+		std::size_t primitives;
+	};
+
+	struct Wave
+	{
+		Mesh::Ptr mesh;
+		std::size_t resolution;
+		float size;
+		float amplitude;
+	};
+
+	bool parseLine(const std::vector<std::string>& tokens);
+
+	void addWave(const Vector3f& position, float size, std::size_t resolution, float amplitude, const Vector3f& colour);
+
+	// Moves every wave's vertices to the given time and streams them with
+	// their new normals
+	void updateWaves(float time);
+
+	Result measure(bool indirect, bool trace);
+
+	void printResult(const std::string& label, const Result& result) const;
+
+	bool measureJobScaling();
+
+	bool measureStringParsing();
+
+	sf::Context m_context;
+
+	bool m_ready;
+
+	unsigned int m_width;
+	unsigned int m_height;
+	unsigned int m_frames;
+	unsigned int m_warmupFrames;
+
+	std::string m_traceFile;
+
+	bool m_indirect;
+	bool m_compare;
+	bool m_jobScaling;
+	bool m_stringParsing;
+
+	FBO m_target;
+
+	GraphicSystem m_graphics;
+
+	CameraPath m_path;
+
+	std::vector<Wave> m_waves;
+};
\ No newline at end of file
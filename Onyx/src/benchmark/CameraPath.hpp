@@ -0,0 +1,95 @@
+#pragma once
+
+#include "math\Vector.hpp"
+#include "math\Angle.hpp"
+#include "math\Quaternion.hpp"
+#include "math\MathHelper.hpp"
+
+#include "rendering\Camera.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// Keyframed fly-through. It is sampled at fixed times rather than wall clock
+// time so every run renders exactly the same sequence of views
+class CameraPath
+{
+public:
+
+	struct Keyframe
+	{
+		float time;
+		Vector3f position;
+		float yaw;		///< Degrees about the world y axis
+		float pitch;	///< Degrees about the camera's x axis
+	};
+
+	void addKeyframe(float time, const Vector3f& position, float yaw, float pitch)
+	{
+		m_keyframes.push_back({ time, position, yaw, pitch });
+
+		std::sort(m_keyframes.begin(), m_keyframes.end(),
+			[](const Keyframe& a, const Keyframe& b) { return a.time < b.time; });
+	}
+
+	void clear()
+	{
+		m_keyframes.clear();
+	}
+
+	bool isEmpty() const
+	{
+		return m_keyframes.empty();
+	}
+
+	float getDuration() const
+	{
+		return m_keyframes.empty() ? 0.0f : m_keyframes.back().time;
+	}
+
+	// Position the camera at the given time, looping once the path ends
+	void apply(Camera& camera, float time) const
+	{
+		if (m_keyframes.empty())
+		{
+			return;
+		}
+
+		if (getDuration() > 0.0f)
+		{
+			time = std::fmod(time, getDuration());
+		}
+
+		Keyframe a = m_keyframes.front();
+		Keyframe b = m_keyframes.front();
+
+		for (std::size_t i = 1; i < m_keyframes.size(); ++i)
+		{
+			b = m_keyframes[i];
+
+			if (b.time >= time)
+			{
+				break;
+			}
+
+			a = b;
+		}
+
+		const float span = b.time - a.time;
+		const float t = (span > 0.0f) ? Clamp((time - a.time) / span, 0.0f, 1.0f) : 0.0f;
+
+		const float yaw = a.yaw + (b.yaw - a.yaw) * t;
+		const float pitch = a.pitch + (b.pitch - a.pitch) * t;
+
+		camera.setPosition(a.position.Lerp(b.position, t));
+		camera.setRotation(Quaternion(Vector3f::xAxis(), degrees(pitch)) * Quaternion(Vector3f::yAxis(), degrees(yaw)));
+
+		// Nothing to blend with, we jump straight to each sample
+		camera.storePreviousState();
+	}
+
+private:
+
+	std::vector<Keyframe> m_keyframes;
+};
\ No newline at end of file
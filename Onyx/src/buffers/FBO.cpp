@@ -0,0 +1,138 @@
+#include "FBO.hpp"
+
+#include <iostream>
+#include <utility>
+
+FBO::FBO() :
+	m_name(0u),
+	m_colour(0u),
+	m_depth(0u),
+	m_width(0),
+	m_height(0)
+{
+}
+
+FBO::~FBO()
+{
+	destroy();
+}
+
+FBO::FBO(FBO&& other) :
+	m_name(0u),
+	m_colour(0u),
+	m_depth(0u),
+	m_width(0),
+	m_height(0)
+{
+	std::swap(m_name, other.m_name);
+	std::swap(m_colour, other.m_colour);
+	std::swap(m_depth, other.m_depth);
+	std::swap(m_width, other.m_width);
+	std::swap(m_height, other.m_height);
+}
+
+FBO& FBO::operator=(FBO&& other)
+{
+	if (this != &other)
+	{
+		destroy();
+
+		std::swap(m_name, other.m_name);
+		std::swap(m_colour, other.m_colour);
+		std::swap(m_depth, other.m_depth);
+		std::swap(m_width, other.m_width);
+		std::swap(m_height, other.m_height);
+	}
+
+	return *this;
+}
+
+bool FBO::create(GLsizei width, GLsizei height)
+{
+	destroy();
+
+	m_width = width;
+	m_height = height;
+
+	glGenFramebuffers(1, &m_name);
+	glGenRenderbuffers(1, &m_colour);
+	glGenRenderbuffers(1, &m_depth);
+
+	glBindRenderbuffer(GL_RENDERBUFFER, m_colour);
+	check_gl_error(glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height));
+
+	glBindRenderbuffer(GL_RENDERBUFFER, m_depth);
+	check_gl_error(glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height));
+
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	bind();
+
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, m_colour);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, m_depth);
+
+	GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+
+	unbind();
+
+	if (status != GL_FRAMEBUFFER_COMPLETE)
+	{
+		std::cout << "Framebuffer incomplete: 0x" << std::hex << status << std::dec << std::endl;
+
+		destroy();
+
+		return false;
+	}
+
+	return true;
+}
+
+GLuint FBO::name() const
+{
+	return m_name;
+}
+
+GLsizei FBO::getWidth() const
+{
+	return m_width;
+}
+
+GLsizei FBO::getHeight() const
+{
+	return m_height;
+}
+
+void FBO::bind() const
+{
+	check_gl_error(glBindFramebuffer(GL_FRAMEBUFFER, m_name));
+}
+
+void FBO::unbind() const
+{
+	check_gl_error(glBindFramebuffer(GL_FRAMEBUFFER, 0));
+}
+
+void FBO::readPixels(void* buffer) const
+{
+	bind();
+
+	glReadBuffer(GL_COLOR_ATTACHMENT0);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	check_gl_error(glReadPixels(0, 0, m_width, m_height, GL_RGBA, GL_UNSIGNED_BYTE, buffer));
+
+	unbind();
+}
+
+void FBO::destroy()
+{
+	if (m_name)
+	{
+		glDeleteFramebuffers(1, &m_name);
+		glDeleteRenderbuffers(1, &m_colour);
+		glDeleteRenderbuffers(1, &m_depth);
+	}
+
+	m_name = 0u;
+	m_colour = 0u;
+	m_depth = 0u;
+}
\ No newline at end of file
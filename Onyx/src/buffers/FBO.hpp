@@ -0,0 +1,49 @@
+#pragma once
+
+#include "GL\glew.h"
+
+#define check_gl_error
+
+// Offscreen render target with a colour and a depth renderbuffer
+class FBO
+{
+public:
+
+	FBO();
+
+	~FBO();
+
+	FBO(const FBO& other) = delete;
+
+	FBO operator = (const FBO&) = delete;
+
+	FBO(FBO&& other);
+
+	FBO& operator=(FBO&& other);
+
+	bool create(GLsizei width, GLsizei height);
+
+	GLuint name() const;
+
+	GLsizei getWidth() const;
+
+	GLsizei getHeight() const;
+
+	void bind() const;
+
+	void unbind() const;
+
+	// Reads back the colour attachment as tightly packed RGBA8
+	void readPixels(void* buffer) const;
+
+private:
+
+	void destroy();
+
+	GLuint m_name;
+	GLuint m_colour;
+	GLuint m_depth;
+
+	GLsizei m_width;
+	GLsizei m_height;
+};
\ No newline at end of file
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <iterator>
+#include <limits>
+#include <map>
+
+// Hands out ranges of a fixed size space, e.g. elements of a GPU buffer.
+// Free blocks are kept sorted by offset so neighbours merge when released
+class FreeListAllocator
+{
+public:
+
+	static const std::size_t InvalidOffset = std::numeric_limits<std::size_t>::max();
+
+	explicit FreeListAllocator(std::size_t capacity = 0)
+		:
+		m_capacity(0),
+		m_free(0)
+	{
+		grow(capacity);
+	}
+
+	// First fit, returns InvalidOffset if no free block is large enough
+	std::size_t allocate(std::size_t size)
+	{
+		if (size == 0)
+		{
+			return 0;
+		}
+
+		for (auto it = m_blocks.begin(); it != m_blocks.end(); ++it)
+		{
+			if (it->second >= size)
+			{
+				const std::size_t offset = it->first;
+				const std::size_t remaining = it->second - size;
+
+				m_blocks.erase(it);
+
+				if (remaining > 0)
+				{
+					m_blocks[offset + size] = remaining;
+				}
+
+				m_free -= size;
+
+				return offset;
+			}
+		}
+
+		return InvalidOffset;
+	}
+
+	void free(std::size_t offset, std::size_t size)
+	{
+		if (size == 0)
+		{
+			return;
+		}
+
+		assert(offset + size <= m_capacity);
+
+		m_free += size;
+
+		auto next = m_blocks.lower_bound(offset);
+
+		// Merge with the following block
+		if (next != m_blocks.end() && offset + size == next->first)
+		{
+			size += next->second;
+			next = m_blocks.erase(next);
+		}
+
+		// Merge with the preceding block
+		if (next != m_blocks.begin())
+		{
+			auto previous = std::prev(next);
+
+			if (previous->first + previous->second == offset)
+			{
+				previous->second += size;
+				return;
+			}
+		}
+
+		m_blocks[offset] = size;
+	}
+
+	// Extend the space, the new range is free
+	void grow(std::size_t capacity)
+	{
+		if (capacity > m_capacity)
+		{
+			const std::size_t offset = m_capacity;
+			m_capacity = capacity;
+
+			free(offset, capacity - offset);
+		}
+	}
+
+	// Everything before used is allocated and everything after it is free,
+	// as after compacting the allocations to the front
+	void reset(std::size_t used)
+	{
+		assert(used <= m_capacity);
+
+		m_blocks.clear();
+		m_free = 0;
+
+		free(used, m_capacity - used);
+	}
+
+	std::size_t getCapacity() const
+	{
+		return m_capacity;
+	}
+
+	std::size_t getFreeSize() const
+	{
+		return m_free;
+	}
+
+	std::size_t getUsedSize() const
+	{
+		return m_capacity - m_free;
+	}
+
+	std::size_t getLargestFreeBlock() const
+	{
+		std::size_t largest = 0;
+
+		for (auto& block : m_blocks)
+		{
+			largest = std::max(largest, block.second);
+		}
+
+		return largest;
+	}
+
+private:
+
+	std::size_t m_capacity;
+	std::size_t m_free;
+
+	std::map<std::size_t, std::size_t> m_blocks;	///< Free blocks, offset -> size
+};
\ No newline at end of file
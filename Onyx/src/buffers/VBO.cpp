@@ -1,40 +1,63 @@
 #include "VBO.hpp"
 
+#include "profiling\Profiler.hpp"
+
+#include <algorithm>
 #include <cassert>
+#include <cstring>
 #include <utility>
 
-VBO::VBO(GLenum target, GLenum usage) : m_target(target), m_usage(usage)
+VBO::VBO(GLenum target, GLenum usage) :
+	m_target(target),
+	m_usage(usage),
+	m_size(0),
+	m_mapped(nullptr),
+	m_region(0)
 {
 	glGenBuffers(1, &m_name);
 }
 
 VBO::~VBO()
 {
-	glDeleteBuffers(1, &m_name);
+	release();
+
+	// Moved from, or already deleted while there was a context to do it
+	if (m_name != 0)
+	{
+		glDeleteBuffers(1, &m_name);
+	}
 }
 
 
 VBO::VBO(VBO&& other) :
 	m_name(0u),
 	m_target(0u),
-	m_usage(0u)
+	m_usage(0u),
+	m_size(0),
+	m_mapped(nullptr),
+	m_region(0)
 {
 	std::swap(m_name, other.m_name);
 	std::swap(m_target, other.m_target);
 	std::swap(m_usage, other.m_usage);
+	std::swap(m_size, other.m_size);
+	std::swap(m_mapped, other.m_mapped);
+	std::swap(m_region, other.m_region);
+	std::swap(m_regions, other.m_regions);
 }
 
 VBO& VBO::operator=(VBO&& other)
 {
 	if (this != &other)
 	{
-		m_name = 0u;
-		m_target = 0u;
-		m_usage = 0u;
-
+		// Swap rather than clear so other releases the buffer we held
 		std::swap(m_name, other.m_name);
 		std::swap(m_target, other.m_target);
 		std::swap(m_usage, other.m_usage);
+		std::swap(m_size, other.m_size);
+		std::swap(m_mapped, other.m_mapped);
+		std::swap(m_region, other.m_region);
+		std::swap(m_regions, other.m_regions);
 	}
 
 	return *this;
@@ -57,11 +80,180 @@ void VBO::unbind() const
 
 void VBO::data(GLsizeiptr data_size, const GLvoid* data_ptr)
 {
+	PROFILE_FUNCTION();
+
 	assert(data_size >= 0);
 
+	// Immutable storage can't be respecified, start again with a new buffer
+	if (isPersistent())
+	{
+		release();
+
+		glDeleteBuffers(1, &m_name);
+		glGenBuffers(1, &m_name);
+	}
+
 	bind();
 
 	check_gl_error(glBufferData(m_target, data_size, data_ptr, m_usage));
 
 	unbind();
+
+	m_size = data_size;
+}
+
+void VBO::subData(GLintptr offset, GLsizeiptr data_size, const GLvoid* data_ptr)
+{
+	PROFILE_FUNCTION();
+
+	assert(!isPersistent());
+	assert(offset >= 0 && offset + data_size <= m_size);
+
+	bind();
+
+	check_gl_error(glBufferSubData(m_target, offset, data_size, data_ptr));
+
+	unbind();
+}
+
+bool VBO::storage(GLsizeiptr data_size, const GLvoid* data_ptr, unsigned int regions)
+{
+	PROFILE_FUNCTION();
+
+	assert(data_size > 0 && regions > 0);
+
+	release();
+
+	glDeleteBuffers(1, &m_name);
+	glGenBuffers(1, &m_name);
+
+	const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+	bind();
+
+	check_gl_error(glBufferStorage(m_target, data_size * regions, nullptr, flags));
+
+	m_mapped = static_cast<char*>(glMapBufferRange(m_target, 0, data_size * regions, flags));
+
+	unbind();
+
+	if (!m_mapped)
+	{
+		return false;
+	}
+
+	m_size = data_size;
+	m_region = 0;
+	m_regions.assign(regions, Region{ nullptr, 0, 0 });
+
+	if (data_ptr)
+	{
+		for (unsigned int i = 0; i < regions; ++i)
+		{
+			std::memcpy(m_mapped + i * data_size, data_ptr, data_size);
+		}
+	}
+
+	return true;
+}
+
+void VBO::stream(const GLvoid* contents, GLintptr offset, GLsizeiptr data_size)
+{
+	PROFILE_FUNCTION();
+
+	assert(isPersistent());
+	assert(offset >= 0 && offset + data_size <= m_size);
+
+	// Everyone else now needs this range
+	for (auto& region : m_regions)
+	{
+		if (region.staleBegin == region.staleEnd)
+		{
+			region.staleBegin = offset;
+			region.staleEnd = offset + data_size;
+		}
+		else
+		{
+			region.staleBegin = std::min(region.staleBegin, offset);
+			region.staleEnd = std::max(region.staleEnd, offset + data_size);
+		}
+	}
+
+	m_region = (m_region + 1) % m_regions.size();
+
+	Region& region = m_regions[m_region];
+
+	if (region.fence)
+	{
+		PROFILE_SCOPE("Wait for buffer fence");
+
+		// With three regions this only blocks if the GPU is several frames behind
+		while (glClientWaitSync(region.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED)
+		{
+		}
+
+		glDeleteSync(region.fence);
+		region.fence = nullptr;
+	}
+
+	const char* source = static_cast<const char*>(contents);
+
+	std::memcpy(m_mapped + regionOffset() + region.staleBegin, source + region.staleBegin, region.staleEnd - region.staleBegin);
+
+	region.staleBegin = region.staleEnd = 0;
+}
+
+void VBO::fence()
+{
+	if (!isPersistent())
+	{
+		return;
+	}
+
+	Region& region = m_regions[m_region];
+
+	// A later fence covers everything before it
+	if (region.fence)
+	{
+		glDeleteSync(region.fence);
+	}
+
+	region.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+bool VBO::isPersistent() const
+{
+	return m_mapped != nullptr;
+}
+
+GLsizeiptr VBO::size() const
+{
+	return m_size;
+}
+
+GLintptr VBO::regionOffset() const
+{
+	return isPersistent() ? m_region * m_size : 0;
+}
+
+void VBO::release()
+{
+	for (auto& region : m_regions)
+	{
+		if (region.fence)
+		{
+			glDeleteSync(region.fence);
+		}
+	}
+
+	m_regions.clear();
+
+	if (m_mapped)
+	{
+		bind();
+		glUnmapBuffer(m_target);
+		unbind();
+
+		m_mapped = nullptr;
+	}
 }
\ No newline at end of file
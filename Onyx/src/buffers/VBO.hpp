@@ -2,6 +2,8 @@
 
 #include "GL\glew.h"
 
+#include <vector>
+
 //#include "ErrorCheck.hpp"
 #define check_gl_error
 
@@ -29,10 +31,52 @@ public:
 
 	void data(GLsizeiptr data_size, const GLvoid* data_ptr);
 
+	// Overwrite part of a buffer allocated with data()
+	void subData(GLintptr offset, GLsizeiptr data_size, const GLvoid* data_ptr);
+
+	// Persistent mapped mode for data that changes while it's in use. The
+	// buffer is split into regions that are written in turn, each guarded by a
+	// fence, so the CPU never writes to a region the GPU may still be reading.
+	// This replaces the buffer object, anything referencing it (e.g. a VAO) has
+	// to be pointed at the new one
+	bool storage(GLsizeiptr data_size, const GLvoid* data_ptr, unsigned int regions = 3);
+
+	// Move on to the next region and bring it up to date. The whole of the
+	// current contents are passed in but only the changed range plus whatever
+	// the region missed while it was in flight is copied
+	void stream(const GLvoid* contents, GLintptr offset, GLsizeiptr data_size);
+
+	// Fence the current region once the draws that read it have been issued
+	void fence();
+
+	bool isPersistent() const;
+
+	// Size of the data in bytes, i.e. of one region for persistent buffers
+	GLsizeiptr size() const;
+
+	// Byte offset of the region draws should read from
+	GLintptr regionOffset() const;
+
 private:
 
+	void release();
+
 	GLenum m_target;
 	GLenum m_usage;
 
 	GLuint m_name;
+
+	GLsizeiptr m_size;
+
+	char* m_mapped;
+	unsigned int m_region;
+
+	struct Region
+	{
+		GLsync fence;
+		GLintptr staleBegin;	///< Bytes written to other regions since this one was last current
+		GLintptr staleEnd;
+	};
+
+	std::vector<Region> m_regions;
 };
\ No newline at end of file
@@ -0,0 +1,501 @@
+#include "InputReplay.hpp"
+
+#include <cstring>
+#include <iostream>
+
+namespace
+{
+	const char magic[8] = { 'O', 'N', 'Y', 'X', 'I', 'N', 'P', 'T' };
+	const uint32_t version = 1;
+
+	const std::size_t keyBytes = (InputState::KeyCount + 7) / 8;
+	const std::size_t flushSize = 64 * 1024;
+
+	enum TickFlags : uint8_t
+	{
+		KeysChanged = 1 << 0,
+		HasEvents = 1 << 1
+	};
+
+	template <class T>
+	void write(std::vector<char>& buffer, T value)
+	{
+		const char* bytes = reinterpret_cast<const char*>(&value);
+		buffer.insert(buffer.end(), bytes, bytes + sizeof(T));
+	}
+
+	template <class T>
+	bool read(const std::vector<char>& buffer, std::size_t& offset, T& value)
+	{
+		if (offset + sizeof(T) > buffer.size())
+		{
+			return false;
+		}
+
+		std::memcpy(&value, &buffer[offset], sizeof(T));
+		offset += sizeof(T);
+
+		return true;
+	}
+
+	void writeKeys(std::vector<char>& buffer, const InputState& keys)
+	{
+		for (std::size_t byte = 0; byte < keyBytes; ++byte)
+		{
+			uint8_t bits = 0;
+
+			for (std::size_t bit = 0; bit < 8; ++bit)
+			{
+				std::size_t key = byte * 8 + bit;
+
+				if (key < InputState::KeyCount && keys.isKeyPressed(static_cast<sf::Keyboard::Key>(key)))
+				{
+					bits |= (1 << bit);
+				}
+			}
+
+			write(buffer, bits);
+		}
+	}
+
+	bool readKeys(const std::vector<char>& buffer, std::size_t& offset, InputState& keys)
+	{
+		for (std::size_t byte = 0; byte < keyBytes; ++byte)
+		{
+			uint8_t bits = 0;
+
+			if (!read(buffer, offset, bits))
+			{
+				return false;
+			}
+
+			for (std::size_t bit = 0; bit < 8; ++bit)
+			{
+				std::size_t key = byte * 8 + bit;
+
+				if (key < InputState::KeyCount)
+				{
+					keys.setKeyPressed(static_cast<sf::Keyboard::Key>(key), (bits & (1 << bit)) != 0);
+				}
+			}
+		}
+
+		return true;
+	}
+
+	void writeEvent(std::vector<char>& buffer, const sf::Event& event)
+	{
+		write(buffer, static_cast<uint8_t>(event.type));
+
+		switch (event.type)
+		{
+		case sf::Event::KeyPressed:
+		case sf::Event::KeyReleased:
+			write(buffer, static_cast<int16_t>(event.key.code));
+			write(buffer, static_cast<uint8_t>(event.key.alt | (event.key.control << 1) | (event.key.shift << 2) | (event.key.system << 3)));
+			break;
+		case sf::Event::MouseButtonPressed:
+		case sf::Event::MouseButtonReleased:
+			write(buffer, static_cast<uint8_t>(event.mouseButton.button));
+			write(buffer, static_cast<int32_t>(event.mouseButton.x));
+			write(buffer, static_cast<int32_t>(event.mouseButton.y));
+			break;
+		case sf::Event::MouseMotion:
+			write(buffer, static_cast<int32_t>(event.mouseMotion.dx));
+			write(buffer, static_cast<int32_t>(event.mouseMotion.dy));
+			break;
+		case sf::Event::MouseMoved:
+			write(buffer, static_cast<int32_t>(event.mouseMove.x));
+			write(buffer, static_cast<int32_t>(event.mouseMove.y));
+			break;
+		case sf::Event::MouseWheelScrolled:
+			write(buffer, static_cast<uint8_t>(event.mouseWheelScroll.wheel));
+			write(buffer, static_cast<float>(event.mouseWheelScroll.delta));
+			write(buffer, static_cast<int32_t>(event.mouseWheelScroll.x));
+			write(buffer, static_cast<int32_t>(event.mouseWheelScroll.y));
+			break;
+		default:
+			break;
+		}
+	}
+
+	bool readEvent(const std::vector<char>& buffer, std::size_t& offset, sf::Event& event)
+	{
+		uint8_t type = 0;
+
+		if (!read(buffer, offset, type))
+		{
+			return false;
+		}
+
+		event.type = static_cast<sf::Event::EventType>(type);
+
+		bool ok = true;
+
+		switch (event.type)
+		{
+		case sf::Event::KeyPressed:
+		case sf::Event::KeyReleased:
+		{
+			int16_t code = 0;
+			uint8_t modifiers = 0;
+			ok = read(buffer, offset, code) && read(buffer, offset, modifiers);
+			event.key.code = static_cast<sf::Keyboard::Key>(code);
+			event.key.alt = (modifiers & 1) != 0;
+			event.key.control = (modifiers & 2) != 0;
+			event.key.shift = (modifiers & 4) != 0;
+			event.key.system = (modifiers & 8) != 0;
+			break;
+		}
+		case sf::Event::MouseButtonPressed:
+		case sf::Event::MouseButtonReleased:
+		{
+			uint8_t button = 0;
+			int32_t x = 0, y = 0;
+			ok = read(buffer, offset, button) && read(buffer, offset, x) && read(buffer, offset, y);
+			event.mouseButton.button = static_cast<sf::Mouse::Button>(button);
+			event.mouseButton.x = x;
+			event.mouseButton.y = y;
+			break;
+		}
+		case sf::Event::MouseMotion:
+		{
+			int32_t dx = 0, dy = 0;
+			ok = read(buffer, offset, dx) && read(buffer, offset, dy);
+			event.mouseMotion.dx = dx;
+			event.mouseMotion.dy = dy;
+			break;
+		}
+		case sf::Event::MouseMoved:
+		{
+			int32_t x = 0, y = 0;
+			ok = read(buffer, offset, x) && read(buffer, offset, y);
+			event.mouseMove.x = x;
+			event.mouseMove.y = y;
+			break;
+		}
+		case sf::Event::MouseWheelScrolled:
+		{
+			uint8_t wheel = 0;
+			float delta = 0.0f;
+			int32_t x = 0, y = 0;
+			ok = read(buffer, offset, wheel) && read(buffer, offset, delta) && read(buffer, offset, x) && read(buffer, offset, y);
+			event.mouseWheelScroll.wheel = static_cast<sf::Mouse::Wheel>(wheel);
+			event.mouseWheelScroll.delta = delta;
+			event.mouseWheelScroll.x = x;
+			event.mouseWheelScroll.y = y;
+			break;
+		}
+		default:
+			ok = false;
+			break;
+		}
+
+		return ok;
+	}
+}
+
+InputReplay::InputReplay()
+	:
+	m_recording(false),
+	m_playing(false),
+	m_finished(false),
+	m_readOffset(0),
+	m_ticks(0)
+{
+}
+
+InputReplay::~InputReplay()
+{
+	stopRecording();
+}
+
+bool InputReplay::startRecording(const std::string& filename, const Transform& pose, sf::Time timePerTick)
+{
+	stopRecording();
+	stopPlayback();
+
+	m_file.open(filename.c_str(), std::ios_base::binary | std::ios_base::trunc);
+
+	if (!m_file)
+	{
+		std::cout << "Failed to open input log for writing: " << filename << std::endl;
+		return false;
+	}
+
+	m_buffer.clear();
+	m_buffer.insert(m_buffer.end(), magic, magic + sizeof(magic));
+	write(m_buffer, version);
+	write(m_buffer, static_cast<uint32_t>(timePerTick.asMicroseconds()));
+
+	const Vector3f& position = pose.getPosition();
+	const Quaternion& rotation = pose.getRotation();
+
+	write(m_buffer, position.x);
+	write(m_buffer, position.y);
+	write(m_buffer, position.z);
+	write(m_buffer, rotation.x);
+	write(m_buffer, rotation.y);
+	write(m_buffer, rotation.z);
+	write(m_buffer, rotation.w);
+
+	// Force the first tick to write the full key state
+	m_keys = InputState();
+	writeKeys(m_buffer, m_keys);
+
+	m_ticks = 0;
+	m_clock.restart();
+	m_recording = true;
+
+	std::cout << "\nRecording input to " << filename << std::endl;
+
+	return true;
+}
+
+void InputReplay::stopRecording()
+{
+	if (m_recording)
+	{
+		flush();
+		m_file.close();
+
+		m_recording = false;
+
+		std::cout << "\nRecorded " << m_ticks << " input ticks" << std::endl;
+	}
+}
+
+bool InputReplay::startPlayback(const std::string& filename, Transform& pose, sf::Time timePerTick)
+{
+	stopRecording();
+	stopPlayback();
+
+	std::ifstream file(filename.c_str(), std::ios_base::binary);
+
+	if (!file)
+	{
+		std::cout << "Failed to open input log: " << filename << std::endl;
+		return false;
+	}
+
+	m_buffer.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+	m_readOffset = sizeof(magic);
+
+	uint32_t fileVersion = 0;
+	uint32_t tickLength = 0;
+	float p[3], q[4];
+
+	bool ok = m_buffer.size() >= sizeof(magic) && std::memcmp(m_buffer.data(), magic, sizeof(magic)) == 0 &&
+		read(m_buffer, m_readOffset, fileVersion) && fileVersion == version &&
+		read(m_buffer, m_readOffset, tickLength);
+
+	for (int i = 0; ok && i < 3; ++i) ok = read(m_buffer, m_readOffset, p[i]);
+	for (int i = 0; ok && i < 4; ++i) ok = read(m_buffer, m_readOffset, q[i]);
+
+	ok = ok && readKeys(m_buffer, m_readOffset, m_keys);
+
+	if (!ok)
+	{
+		std::cout << "Invalid input log: " << filename << std::endl;
+		m_buffer.clear();
+		return false;
+	}
+
+	if (tickLength != static_cast<uint32_t>(timePerTick.asMicroseconds()))
+	{
+		std::cout << "Warning: " << filename << " was recorded with a " << tickLength
+			<< "us tick, replay will not match the original session" << std::endl;
+	}
+
+	pose.setPosition(p[0], p[1], p[2]);
+	pose.setRotation(Quaternion(q[0], q[1], q[2], q[3]));
+
+	m_ticks = 0;
+	m_finished = false;
+	m_playing = true;
+
+	std::cout << "\nReplaying input from " << filename << std::endl;
+
+	return true;
+}
+
+void InputReplay::stopPlayback()
+{
+	if (m_playing)
+	{
+		m_playing = false;
+		m_buffer.clear();
+
+		std::cout << "\nReplayed " << m_ticks << " input ticks" << std::endl;
+	}
+}
+
+bool InputReplay::isRecording() const
+{
+	return m_recording;
+}
+
+bool InputReplay::isPlaying() const
+{
+	return m_playing;
+}
+
+bool InputReplay::playbackFinished()
+{
+	bool finished = m_finished;
+	m_finished = false;
+
+	return finished;
+}
+
+bool InputReplay::isRecordable(const sf::Event& event)
+{
+	switch (event.type)
+	{
+	case sf::Event::KeyPressed:
+	case sf::Event::KeyReleased:
+	case sf::Event::MouseButtonPressed:
+	case sf::Event::MouseButtonReleased:
+	case sf::Event::MouseMotion:
+	case sf::Event::MouseMoved:
+	case sf::Event::MouseWheelScrolled:
+		return true;
+	default:
+		return false;
+	}
+}
+
+void InputReplay::processTick(std::vector<sf::Event>& events, InputState& keys)
+{
+	if (m_recording)
+	{
+		writeTick(events, keys);
+	}
+	else if (m_playing)
+	{
+		// Keep the live window events, swap the device input for the recorded input
+		std::vector<sf::Event> recorded;
+
+		for (auto& event : events)
+		{
+			if (!isRecordable(event))
+			{
+				recorded.push_back(event);
+			}
+		}
+
+		if (!readTick(recorded, m_keys))
+		{
+			stopPlayback();
+			m_finished = true;
+			return;
+		}
+
+		events.swap(recorded);
+		keys = m_keys;
+	}
+}
+
+void InputReplay::writeTick(const std::vector<sf::Event>& events, const InputState& keys)
+{
+	uint16_t count = 0;
+
+	for (auto& event : events)
+	{
+		if (isRecordable(event))
+		{
+			count++;
+		}
+	}
+
+	uint8_t flags = 0;
+
+	if (keys != m_keys)
+	{
+		flags |= KeysChanged;
+	}
+	if (count > 0)
+	{
+		flags |= HasEvents;
+	}
+
+	write(m_buffer, flags);
+
+	if (flags & KeysChanged)
+	{
+		writeKeys(m_buffer, keys);
+		m_keys = keys;
+	}
+
+	if (flags & HasEvents)
+	{
+		write(m_buffer, static_cast<uint32_t>(m_clock.getElapsedTime().asMicroseconds()));
+		write(m_buffer, count);
+
+		for (auto& event : events)
+		{
+			if (isRecordable(event))
+			{
+				writeEvent(m_buffer, event);
+			}
+		}
+	}
+
+	m_ticks++;
+
+	if (m_buffer.size() >= flushSize)
+	{
+		flush();
+	}
+}
+
+bool InputReplay::readTick(std::vector<sf::Event>& events, InputState& keys)
+{
+	uint8_t flags = 0;
+
+	if (!read(m_buffer, m_readOffset, flags))
+	{
+		return false;
+	}
+
+	if ((flags & KeysChanged) && !readKeys(m_buffer, m_readOffset, keys))
+	{
+		return false;
+	}
+
+	if (flags & HasEvents)
+	{
+		uint32_t time = 0;
+		uint16_t count = 0;
+
+		if (!read(m_buffer, m_readOffset, time) || !read(m_buffer, m_readOffset, count))
+		{
+			return false;
+		}
+
+		for (uint16_t i = 0; i < count; ++i)
+		{
+			sf::Event event;
+
+			if (!readEvent(m_buffer, m_readOffset, event))
+			{
+				return false;
+			}
+
+			events.push_back(event);
+		}
+	}
+
+	m_ticks++;
+
+	return true;
+}
+
+void InputReplay::flush()
+{
+	if (!m_buffer.empty())
+	{
+		m_file.write(m_buffer.data(), m_buffer.size());
+		m_buffer.clear();
+	}
+}
\ No newline at end of file
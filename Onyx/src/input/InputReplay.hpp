@@ -0,0 +1,77 @@
+#pragma once
+
+#include "InputState.hpp"
+
+#include "rendering\Transform.hpp"
+
+#include "SFML\System\Clock.hpp"
+#include "SFML\Window\Event.hpp"
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Records the input consumed by every fixed update tick to a compact binary
+// log, or feeds a previously recorded log back in place of live input. As the
+// simulation only advances in fixed ticks, replaying the same log reproduces
+// the same session bit for bit regardless of frame rate.
+//
+// Log layout (little endian):
+//   header: "ONYXINPT", u32 version, u32 tick length (us), start pose (7 floats)
+//   per tick: u8 flags
+//     [flags & KeysChanged] key bitset, one bit per sf::Keyboard::Key
+//     [flags & HasEvents]   u32 time since start (us), u16 count, events
+class InputReplay
+{
+public:
+
+	InputReplay();
+
+	~InputReplay();
+
+	// The pose of the transform is saved so playback starts from the same place
+	bool startRecording(const std::string& filename, const Transform& pose, sf::Time timePerTick);
+
+	void stopRecording();
+
+	bool startPlayback(const std::string& filename, Transform& pose, sf::Time timePerTick);
+
+	void stopPlayback();
+
+	bool isRecording() const;
+
+	bool isPlaying() const;
+
+	// Returns true once, on the tick after the last recorded one
+	bool playbackFinished();
+
+	// Called once per update tick with the events polled this tick and the live
+	// keyboard state. While recording they are written out, during playback they
+	// are replaced with the recorded ones
+	void processTick(std::vector<sf::Event>& events, InputState& keys);
+
+	// Only device input is recorded, window events always come from the live window
+	static bool isRecordable(const sf::Event& event);
+
+private:
+
+	void writeTick(const std::vector<sf::Event>& events, const InputState& keys);
+
+	bool readTick(std::vector<sf::Event>& events, InputState& keys);
+
+	void flush();
+
+	std::ofstream m_file;
+
+	bool m_recording;
+	bool m_playing;
+	bool m_finished;
+
+	sf::Clock m_clock;
+
+	InputState m_keys;
+
+	std::vector<char> m_buffer;
+	std::size_t m_readOffset;
+	unsigned int m_ticks;
+};
\ No newline at end of file
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "SFML\Window\Keyboard.hpp"
+
+#include <bitset>
+
+// Snapshot of the keyboard taken once per update tick. Game code reads keys
+// from here instead of sf::Keyboard so a recorded session can be replayed
+class InputState
+{
+public:
+
+	static const std::size_t KeyCount = sf::Keyboard::KeyCount;
+
+	static InputState capture()
+	{
+		InputState state;
+
+		for (int key = 0; key < static_cast<int>(KeyCount); ++key)
+		{
+			state.m_keys[key] = sf::Keyboard::isKeyPressed(static_cast<sf::Keyboard::Key>(key));
+		}
+
+		return state;
+	}
+
+	bool isKeyPressed(sf::Keyboard::Key key) const
+	{
+		return key >= 0 && key < static_cast<int>(KeyCount) && m_keys[key];
+	}
+
+	void setKeyPressed(sf::Keyboard::Key key, bool pressed)
+	{
+		if (key >= 0 && key < static_cast<int>(KeyCount))
+		{
+			m_keys[key] = pressed;
+		}
+	}
+
+	bool operator==(const InputState& rhs) const
+	{
+		return m_keys == rhs.m_keys;
+	}
+
+	bool operator!=(const InputState& rhs) const
+	{
+		return m_keys != rhs.m_keys;
+	}
+
+private:
+
+	std::bitset<KeyCount> m_keys;
+};
\ No newline at end of file
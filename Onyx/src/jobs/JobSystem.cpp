@@ -0,0 +1,363 @@
+#include "JobSystem.hpp"
+
+#include "profiling\Profiler.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <iostream>
+#include <iterator>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace JobSystem
+{
+	struct Job
+	{
+		std::function<void()> task;
+
+		Handle parent;
+
+		std::atomic<int> unfinished{ 1 };		///< The job itself plus its unfinished children
+		std::atomic<int> dependencies{ 1 };		///< Unfinished dependencies, plus one until run() is called
+
+		std::mutex mutex;
+		bool finished = false;
+		std::vector<Handle> continuations;		///< Jobs waiting on this one to finish
+	};
+}
+
+namespace
+{
+	using JobSystem::Job;
+	using JobSystem::Handle;
+
+	struct Queue
+	{
+		std::mutex mutex;
+		std::deque<Handle> jobs;
+	};
+
+	// The first queue is shared by every thread that isn't a worker
+	std::vector<std::unique_ptr<Queue>> queues;
+	std::vector<std::thread> workers;
+
+	thread_local std::size_t localQueue = 0;
+
+	std::atomic<bool> running{ false };
+	std::atomic<int> queued{ 0 };
+
+	std::mutex sleepMutex;
+	std::condition_variable wake;
+
+	void enqueue(const Handle& job);
+
+	void release(const Handle& job)
+	{
+		if (job->dependencies.fetch_sub(1, std::memory_order_acq_rel) == 1)
+		{
+			enqueue(job);
+		}
+	}
+
+	void complete(Handle job)
+	{
+		std::vector<Handle> continuations;
+
+		{
+			std::lock_guard<std::mutex> lock(job->mutex);
+
+			job->finished = true;
+			continuations.swap(job->continuations);
+		}
+
+		for (auto& continuation : continuations)
+		{
+			release(continuation);
+		}
+
+		Handle parent = std::move(job->parent);
+
+		if (parent && parent->unfinished.fetch_sub(1, std::memory_order_acq_rel) == 1)
+		{
+			complete(std::move(parent));
+		}
+	}
+
+	void execute(const Handle& job)
+	{
+		{
+			PROFILE_SCOPE("Job");
+
+			job->task();
+		}
+
+		// Let go of anything the task captured as soon as it's done
+		job->task = nullptr;
+
+		if (job->unfinished.fetch_sub(1, std::memory_order_acq_rel) == 1)
+		{
+			complete(job);
+		}
+	}
+
+	void enqueue(const Handle& job)
+	{
+		if (workers.empty())
+		{
+			execute(job);
+			return;
+		}
+
+		{
+			Queue& queue = *queues[localQueue];
+
+			std::lock_guard<std::mutex> lock(queue.mutex);
+
+			queue.jobs.push_back(job);
+		}
+
+		queued.fetch_add(1, std::memory_order_release);
+
+		// Taking the lock means a worker can't miss the wakeup between checking
+		// for work and going to sleep
+		{
+			std::lock_guard<std::mutex> lock(sleepMutex);
+		}
+
+		wake.notify_one();
+	}
+
+	// Whether the job is the ancestor or one of its children, grandchildren...
+	// The parents of a queued job can't have finished so the chain is intact
+	bool descendsFrom(const Job* job, const Job* ancestor)
+	{
+		for (; job; job = job->parent.get())
+		{
+			if (job == ancestor)
+			{
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	// Takes the first job in [first, last) belonging to the awaited one, or
+	// any job if nothing is being waited on
+	template <class Iterator>
+	Iterator findRunnable(Iterator first, Iterator last, const Job* awaited)
+	{
+		if (!awaited)
+		{
+			return first;
+		}
+
+		return std::find_if(first, last, [awaited](const Handle& job) { return descendsFrom(job.get(), awaited); });
+	}
+
+	// Newest first from our own queue, keeping its data in cache, otherwise the
+	// oldest from someone else's as that's likely the biggest piece of work.
+	// Given an awaited job only it and its children are taken
+	bool tryRun(const Job* awaited = nullptr)
+	{
+		Handle job;
+
+		for (std::size_t i = 0; i < queues.size() && !job; ++i)
+		{
+			const std::size_t index = (localQueue + i) % queues.size();
+
+			Queue& queue = *queues[index];
+
+			std::lock_guard<std::mutex> lock(queue.mutex);
+
+			if (i == 0)
+			{
+				const auto found = findRunnable(queue.jobs.rbegin(), queue.jobs.rend(), awaited);
+
+				if (found != queue.jobs.rend())
+				{
+					job = std::move(*found);
+					queue.jobs.erase(std::next(found).base());
+				}
+			}
+			else
+			{
+				const auto found = findRunnable(queue.jobs.begin(), queue.jobs.end(), awaited);
+
+				if (found != queue.jobs.end())
+				{
+					job = std::move(*found);
+					queue.jobs.erase(found);
+				}
+			}
+		}
+
+		if (!job)
+		{
+			return false;
+		}
+
+		queued.fetch_sub(1, std::memory_order_relaxed);
+
+		execute(job);
+
+		return true;
+	}
+
+	void workerLoop(std::size_t index)
+	{
+		localQueue = index;
+
+		PROFILE_THREAD("Worker " + std::to_string(index));
+
+		while (true)
+		{
+			if (tryRun())
+			{
+				continue;
+			}
+
+			std::unique_lock<std::mutex> lock(sleepMutex);
+
+			wake.wait(lock, []() { return queued.load(std::memory_order_acquire) > 0 || !running; });
+
+			if (!running && queued.load(std::memory_order_acquire) == 0)
+			{
+				break;
+			}
+		}
+	}
+}
+
+namespace JobSystem
+{
+	void init(unsigned int count)
+	{
+		if (running)
+		{
+			shutdown();
+		}
+
+		if (count == 0)
+		{
+			count = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+		}
+
+		queues.emplace_back(new Queue());
+
+		for (unsigned int i = 0; i < count; ++i)
+		{
+			queues.emplace_back(new Queue());
+		}
+
+		running = true;
+
+		for (unsigned int i = 0; i < count; ++i)
+		{
+			workers.emplace_back(workerLoop, i + 1);
+		}
+
+		std::cout << "\nStarted " << count << " job system workers" << std::endl;
+	}
+
+	void shutdown()
+	{
+		{
+			std::lock_guard<std::mutex> lock(sleepMutex);
+
+			running = false;
+		}
+
+		wake.notify_all();
+
+		for (auto& worker : workers)
+		{
+			worker.join();
+		}
+
+		workers.clear();
+		queues.clear();
+	}
+
+	unsigned int getWorkerCount()
+	{
+		return static_cast<unsigned int>(workers.size());
+	}
+
+	unsigned int getConcurrency()
+	{
+		return getWorkerCount() + 1;
+	}
+
+	Handle create(std::function<void()> task)
+	{
+		Handle job = std::make_shared<Job>();
+		job->task = std::move(task);
+
+		return job;
+	}
+
+	Handle createChild(const Handle& parent, std::function<void()> task)
+	{
+		Handle job = create(std::move(task));
+
+		parent->unfinished.fetch_add(1, std::memory_order_relaxed);
+		job->parent = parent;
+
+		return job;
+	}
+
+	void addDependency(const Handle& job, const Handle& dependency)
+	{
+		std::lock_guard<std::mutex> lock(dependency->mutex);
+
+		if (dependency->finished)
+		{
+			return;
+		}
+
+		job->dependencies.fetch_add(1, std::memory_order_relaxed);
+		dependency->continuations.push_back(job);
+	}
+
+	void run(const Handle& job)
+	{
+		release(job);
+	}
+
+	Handle then(const Handle& job, std::function<void()> task)
+	{
+		Handle continuation = create(std::move(task));
+
+		addDependency(continuation, job);
+		run(continuation);
+
+		return continuation;
+	}
+
+	bool isFinished(const Handle& job)
+	{
+		return job->unfinished.load(std::memory_order_acquire) == 0;
+	}
+
+	void wait(const Handle& job)
+	{
+		// Threads that aren't workers, like the render thread, only help with
+		// the job they're waiting on. Anything else could be a whole file
+		// import that holds them up far longer than the wait itself. Workers
+		// take anything, as the job they're waiting on may depend on it
+		const Job* awaited = (localQueue == 0) ? job.get() : nullptr;
+
+		while (!isFinished(job))
+		{
+			if (!tryRun(awaited))
+			{
+				std::this_thread::yield();
+			}
+		}
+	}
+}
\ No newline at end of file
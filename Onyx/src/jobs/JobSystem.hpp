@@ -0,0 +1,92 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <memory>
+
+// Work-stealing task scheduler shared by the whole engine. Each worker thread
+// has its own deque, it pushes and pops its own jobs at the back and steals
+// from the front of the others' when it runs dry. Threads that aren't workers
+// submit to a shared queue and, while they wait on a job, help run it and its
+// children but nothing else.
+//
+// Until init() is called (or with zero workers) every job runs straight away
+// on the thread that submits it, so code using the job system doesn't need a
+// separate serial path
+namespace JobSystem
+{
+	struct Job;
+
+	typedef std::shared_ptr<Job> Handle;
+
+	// 0 uses one worker per hardware thread less one for the calling thread
+	void init(unsigned int workers = 0);
+
+	// Finishes every queued job then joins the workers
+	void shutdown();
+
+	unsigned int getWorkerCount();
+
+	// Threads that can run jobs, the workers plus whoever is waiting
+	unsigned int getConcurrency();
+
+	// A job doesn't start until run() is called and every dependency has finished
+	Handle create(std::function<void()> task);
+
+	// The parent doesn't count as finished until the child has. Usually called
+	// from inside the parent's task to split its work up
+	Handle createChild(const Handle& parent, std::function<void()> task);
+
+	// Must be called before run(job)
+	void addDependency(const Handle& job, const Handle& dependency);
+
+	void run(const Handle& job);
+
+	// Create and run a job that starts once the given job has finished
+	Handle then(const Handle& job, std::function<void()> task);
+
+	bool isFinished(const Handle& job);
+
+	// Helps run the job until it has finished rather than blocking
+	void wait(const Handle& job);
+
+	// Calls function(first, last) over [begin, end) in chunks of at most grain
+	// elements spread across the workers, returning once every chunk is done
+	template <class Function>
+	void parallelFor(std::size_t begin, std::size_t end, std::size_t grain, Function function)
+	{
+		if (begin >= end)
+		{
+			return;
+		}
+
+		grain = std::max(grain, std::size_t(1));
+
+		if (getWorkerCount() == 0 || end - begin <= grain)
+		{
+			function(begin, end);
+			return;
+		}
+
+		Handle root = create([]() {});
+
+		for (std::size_t first = begin; first < end; first += grain)
+		{
+			const std::size_t last = std::min(first + grain, end);
+
+			run(createChild(root, [&function, first, last]() { function(first, last); }));
+		}
+
+		run(root);
+		wait(root);
+	}
+
+	// Chunks needed to cover count elements, for sizing per-chunk results
+	inline std::size_t chunkCount(std::size_t count, std::size_t grain)
+	{
+		grain = std::max(grain, std::size_t(1));
+
+		return (count + grain - 1) / grain;
+	}
+}
\ No newline at end of file
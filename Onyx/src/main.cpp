@@ -2,15 +2,186 @@
 
 #include "Utilities.hpp"
 
+#ifdef ONYX_BENCHMARK
+#include "benchmark\Benchmark.hpp"
+#include "jobs\JobSystem.hpp"
+#include "rendering\MeshBinary.hpp"
+
+#include <cstdlib>
+#include <string>
+
+// OnyxBenchmark [scene] [frames] [width] [height] [--trace file.json] [--no-shader-cache] [--no-mesh-cache]
+//               [--indirect | --compare-indirect | --job-scaling | --string-parsing] [--jobs workers]
+int main(int argc, char* argv[])
+{
+	std::string scene = "./res/benchmarks/default.scene";
+	std::string trace;
+	bool indirect = false;
+	bool compare = false;
+	bool jobScaling = false;
+	bool stringParsing = false;
+	unsigned int workers = 0;
+	std::vector<std::string> positional;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string arg = argv[i];
+
+		if (arg == "--trace" && i + 1 < argc)
+		{
+			trace = argv[++i];
+		}
+		else if (arg == "--no-shader-cache")
+		{
+			Shader::setBinaryCacheDirectory("");
+		}
+		else if (arg == "--no-mesh-cache")
+		{
+			MeshBinary::setCacheDirectory("");
+		}
+		else if (arg == "--indirect")
+		{
+			indirect = true;
+		}
+		else if (arg == "--compare-indirect")
+		{
+			compare = true;
+		}
+		else if (arg == "--job-scaling")
+		{
+			jobScaling = true;
+		}
+		else if (arg == "--string-parsing")
+		{
+			stringParsing = true;
+		}
+		else if (arg == "--jobs" && i + 1 < argc)
+		{
+			workers = std::atoi(argv[++i]);
+		}
+		else
+		{
+			positional.push_back(arg);
+		}
+	}
+
+	unsigned int width = 1280;
+	unsigned int height = 720;
+
+	if (positional.size() > 0) scene = positional[0];
+	if (positional.size() > 2) width = std::atoi(positional[2].c_str());
+	if (positional.size() > 3) height = std::atoi(positional[3].c_str());
+
+	JobSystem::init(workers);
+
+	Benchmark benchmark(width, height);
+
+	if (!benchmark.loadScene(scene))
+	{
+		JobSystem::shutdown();
+		return 1;
+	}
+
+	if (positional.size() > 1)
+	{
+		benchmark.setFrameCount(std::atoi(positional[1].c_str()));
+	}
+
+	benchmark.setTraceFile(trace);
+	benchmark.setIndirectDrawing(indirect);
+	benchmark.setCompareDrawPaths(compare);
+	benchmark.setJobScaling(jobScaling);
+	benchmark.setStringParsing(stringParsing);
+
+	const bool passed = benchmark.run();
+
+	JobSystem::shutdown();
+
+	return passed ? 0 : 1;
+}
+#else
 #include "Application.hpp"
+#include "rendering\MeshBinary.hpp"
+#include "rendering\MeshImporter.hpp"
 
-int main() 
+#include <string>
+#include <vector>
+
+// Onyx [--record file] [--replay file] [--no-shader-cache] [--no-mesh-cache] [--stream file.stl]
+//      [model files or directories...]
+int main(int argc, char* argv[])
 {
+	std::string record;
+	std::string replay;
+	std::vector<std::string> models;
+	std::vector<std::string> streamed;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string arg = argv[i];
+
+		if (arg == "--record" && i + 1 < argc)
+		{
+			record = argv[++i];
+		}
+		else if (arg == "--replay" && i + 1 < argc)
+		{
+			replay = argv[++i];
+		}
+		else if (arg == "--stream" && i + 1 < argc)
+		{
+			streamed.push_back(argv[++i]);
+		}
+		else if (arg == "--no-shader-cache")
+		{
+			Shader::setBinaryCacheDirectory("");
+		}
+		else if (arg == "--no-mesh-cache")
+		{
+			MeshBinary::setCacheDirectory("");
+		}
+		else
+		{
+			// A directory adds every model file in it
+			const std::vector<std::string> files = MeshImporter::listDirectory(arg);
+
+			if (files.empty())
+			{
+				models.push_back(arg);
+			}
+			else
+			{
+				models.insert(models.end(), files.begin(), files.end());
+			}
+		}
+	}
+
 	Application app;
+
+	// Laid out in a row along x
+	for (std::size_t i = 0; i < models.size(); ++i)
+	{
+		app.addModel(models[i]).setPosition(static_cast<float>(i), 0.0f, 0.0f);
+	}
+
+	for (auto& filename : streamed)
+	{
+		app.addStreamedModel(filename);
+	}
+
+	if (!record.empty())
+	{
+		app.recordInput(record);
+	}
+	if (!replay.empty())
+	{
+		app.replayInput(replay);
+	}
 	
 	app.run();
 
 	Util::consoleWait();
 
 	return 0;
-}
\ No newline at end of file
+}
+#endif
\ No newline at end of file
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "Vector.hpp"
+#include "Matrix.hpp"
+#include "AABB.hpp"
+
+#include <cmath>
+
+template <class T>
+class Frustum
+{
+public:
+
+	struct Plane
+	{
+		T a, b, c, d;
+
+		T distance(const Vector3<T>& point) const
+		{
+			return a * point.x + b * point.y + c * point.z + d;
+		}
+	};
+
+	// Gribb & Hartmann, the planes come out in whatever space the matrix maps
+	// from, so a model-view-projection gives a frustum in model space
+	Frustum<T>(const Matrix4<T>& m)
+	{
+		for (int i = 0; i < 3; ++i)
+		{
+			planes[i * 2 + 0] = { m[0][3] + m[0][i], m[1][3] + m[1][i], m[2][3] + m[2][i], m[3][3] + m[3][i] };
+			planes[i * 2 + 1] = { m[0][3] - m[0][i], m[1][3] - m[1][i], m[2][3] - m[2][i], m[3][3] - m[3][i] };
+		}
+
+		for (auto& p : planes)
+		{
+			const T length = std::sqrt(p.a * p.a + p.b * p.b + p.c * p.c);
+
+			if (length > T(0))
+			{
+				p.a /= length;
+				p.b /= length;
+				p.c /= length;
+				p.d /= length;
+			}
+		}
+	}
+
+	bool intersects(const Vector3<T>& center, T radius) const
+	{
+		for (auto& p : planes)
+		{
+			if (p.distance(center) < -radius)
+				return false;
+		}
+
+		return true;
+	}
+
+	// Conservative, a box near a corner of the frustum can pass without touching it
+	bool intersects(const AABB<T>& box) const
+	{
+		for (auto& p : planes)
+		{
+			// The corner furthest along the plane's normal
+			const Vector3<T> corner(p.a >= T(0) ? box.max.x : box.min.x,
+									p.b >= T(0) ? box.max.y : box.min.y,
+									p.c >= T(0) ? box.max.z : box.min.z);
+
+			if (p.distance(corner) < T(0))
+				return false;
+		}
+
+		return true;
+	}
+
+	Plane planes[6];
+};
+
+typedef Frustum<float> Frustumf;
\ No newline at end of file
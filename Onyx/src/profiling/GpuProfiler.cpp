@@ -0,0 +1,224 @@
+#include "GpuProfiler.hpp"
+
+#include "GL\glew.h"
+
+#include <iostream>
+#include <vector>
+
+namespace
+{
+	// Enough headroom for the driver to run a few frames ahead, including
+	// software rasterisers like llvmpipe which can lag noticeably
+	const unsigned int framesInFlight = 4;
+
+	const unsigned int noQuery = 0xFFFFFFFF;
+
+	struct PendingScope
+	{
+		const char* name;
+		unsigned int begin;
+		unsigned int end;
+	};
+
+	struct FrameQueries
+	{
+		std::vector<GLuint> queries;
+		std::vector<PendingScope> scopes;
+		unsigned int used = 0;
+		bool pending = false;
+	};
+
+	bool active = false;
+	bool recording = false;
+	bool wasCapturing = false;
+
+	uint32_t track = 0;
+	int64_t clockOffset = 0;
+
+	unsigned int currentFrame = 0;
+	unsigned int droppedFrames = 0;
+
+	FrameQueries frames[framesInFlight];
+
+	unsigned int allocateQuery(FrameQueries& frame)
+	{
+		if (frame.used == frame.queries.size())
+		{
+			const std::size_t grow = 32;
+
+			frame.queries.resize(frame.queries.size() + grow);
+			glGenQueries(grow, &frame.queries[frame.used]);
+		}
+
+		return frame.used++;
+	}
+
+	// GL timestamps live in their own clock domain, line them up with the CPU
+	// profiler's clock so both timelines share an origin in the trace
+	void calibrate()
+	{
+		GLint64 gpuTime = 0;
+		glGetInteger64v(GL_TIMESTAMP, &gpuTime);
+
+		clockOffset = Profiler::now() - gpuTime;
+	}
+
+	bool resolve(FrameQueries& frame)
+	{
+		// Queries retire in order, so if the last one is ready they all are
+		GLint available = 0;
+		glGetQueryObjectiv(frame.queries[frame.used - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+
+		if (!available)
+		{
+			return false;
+		}
+
+		for (auto& scope : frame.scopes)
+		{
+			if (scope.end == noQuery)
+			{
+				continue;
+			}
+
+			GLuint64 begin = 0;
+			GLuint64 end = 0;
+
+			glGetQueryObjectui64v(frame.queries[scope.begin], GL_QUERY_RESULT, &begin);
+			glGetQueryObjectui64v(frame.queries[scope.end], GL_QUERY_RESULT, &end);
+
+			Profiler::record(track, scope.name, static_cast<int64_t>(begin) + clockOffset, static_cast<int64_t>(end) + clockOffset);
+		}
+
+		frame.pending = false;
+
+		return true;
+	}
+}
+
+bool GpuProfiler::init()
+{
+	active = (GLEW_VERSION_3_3 || GLEW_ARB_timer_query);
+
+	if (!active)
+	{
+		std::cout << "\nGPU profiler disabled: timer queries not supported" << std::endl;
+		return false;
+	}
+
+	track = Profiler::createTrack("GPU", "gpu");
+
+	return true;
+}
+
+void GpuProfiler::shutdown()
+{
+	for (auto& frame : frames)
+	{
+		if (!frame.queries.empty())
+		{
+			glDeleteQueries(static_cast<GLsizei>(frame.queries.size()), frame.queries.data());
+		}
+
+		frame = FrameQueries();
+	}
+
+	if (droppedFrames > 0)
+	{
+		std::cout << "\nGPU profiler dropped " << droppedFrames << " frames whose queries were not ready in time" << std::endl;
+	}
+
+	active = false;
+	recording = false;
+}
+
+bool GpuProfiler::isActive()
+{
+	return active;
+}
+
+void GpuProfiler::beginFrame()
+{
+	if (!active)
+	{
+		return;
+	}
+
+	// Read back whatever has finished, oldest first, without ever waiting
+	for (unsigned int i = 1; i <= framesInFlight; ++i)
+	{
+		FrameQueries& frame = frames[(currentFrame + i) % framesInFlight];
+
+		if (frame.pending && !resolve(frame))
+		{
+			break;
+		}
+	}
+
+	currentFrame = (currentFrame + 1) % framesInFlight;
+
+	FrameQueries& frame = frames[currentFrame];
+
+	// Still in flight after a full trip round the ring, give up on it rather than stall
+	if (frame.pending)
+	{
+		frame.pending = false;
+		droppedFrames++;
+	}
+
+	frame.used = 0;
+	frame.scopes.clear();
+
+	const bool capturing = Profiler::isCapturing();
+
+	if (capturing && !wasCapturing)
+	{
+		calibrate();
+	}
+
+	wasCapturing = capturing;
+	recording = capturing;
+}
+
+void GpuProfiler::endFrame()
+{
+	if (recording)
+	{
+		FrameQueries& frame = frames[currentFrame];
+		frame.pending = !frame.scopes.empty();
+
+		recording = false;
+	}
+}
+
+int GpuProfiler::beginScope(const char* name)
+{
+	if (!recording)
+	{
+		return -1;
+	}
+
+	FrameQueries& frame = frames[currentFrame];
+
+	unsigned int query = allocateQuery(frame);
+	glQueryCounter(frame.queries[query], GL_TIMESTAMP);
+
+	frame.scopes.push_back({ name, query, noQuery });
+
+	return static_cast<int>(frame.scopes.size()) - 1;
+}
+
+void GpuProfiler::endScope(int scope)
+{
+	if (scope < 0 || !recording)
+	{
+		return;
+	}
+
+	FrameQueries& frame = frames[currentFrame];
+
+	unsigned int query = allocateQuery(frame);
+	glQueryCounter(frame.queries[query], GL_TIMESTAMP);
+
+	frame.scopes[scope].end = query;
+}
\ No newline at end of file
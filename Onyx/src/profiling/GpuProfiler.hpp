@@ -0,0 +1,58 @@
+#pragma once
+
+#include "Profiler.hpp"
+
+// GPU timings come from GL_TIMESTAMP queries written into a small ring of
+// per-frame query pools. Results are read back a few frames later, only once
+// the driver reports them available, so profiling never stalls the pipeline.
+// Resolved scopes are pushed onto a "GPU" track of the CPU profiler so both
+// show up in the same trace.
+namespace GpuProfiler
+{
+	// Requires a current GL context. Returns false (and stays inert) if the
+	// context has no timer query support
+	bool init();
+
+	void shutdown();
+
+	bool isActive();
+
+	// Resolve finished frames and start recording a new one
+	void beginFrame();
+
+	void endFrame();
+
+	// Returns a handle to pass to endScope, or -1 if nothing was recorded
+	int beginScope(const char* name);
+
+	void endScope(int scope);
+
+	class Scope
+	{
+	public:
+
+		explicit Scope(const char* name)
+			:
+			m_scope(beginScope(name))
+		{}
+
+		~Scope()
+		{
+			endScope(m_scope);
+		}
+
+		Scope(const Scope&) = delete;
+
+		Scope& operator=(const Scope&) = delete;
+
+	private:
+
+		int m_scope;
+	};
+}
+
+#if ONYX_PROFILING
+#define GPU_PROFILE_SCOPE(name) GpuProfiler::Scope PROFILE_CONCAT(gpuProfileScope, __LINE__)(name)
+#else
+#define GPU_PROFILE_SCOPE(name)
+#endif
\ No newline at end of file
@@ -0,0 +1,244 @@
+#include "Profiler.hpp"
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace Profiler
+{
+	std::atomic<bool> capturing(false);
+}
+
+namespace
+{
+	const std::size_t ringCapacity = 1 << 16;
+
+	// Single producer (the owning thread), single consumer (whoever calls flush)
+	struct ThreadBuffer
+	{
+		Profiler::Event events[ringCapacity];
+
+		std::atomic<uint64_t> head{ 0 };
+		std::atomic<uint64_t> tail{ 0 };
+		std::atomic<uint64_t> dropped{ 0 };
+
+		uint32_t id = 0;
+		std::string name;
+		const char* category = "cpu";
+	};
+
+	struct CapturedEvent
+	{
+		Profiler::Event event;
+		uint32_t thread;
+		const char* category;
+	};
+
+	const auto epoch = std::chrono::steady_clock::now();
+
+	std::mutex registryMutex;
+	std::vector<std::unique_ptr<ThreadBuffer>> threadBuffers;
+
+	std::mutex captureMutex;
+	std::vector<CapturedEvent> capturedEvents;
+	uint64_t capturedDropped = 0;
+
+	thread_local ThreadBuffer* localBuffer = nullptr;
+
+	// Must be called with registryMutex held
+	ThreadBuffer* addBuffer()
+	{
+		threadBuffers.emplace_back(new ThreadBuffer());
+
+		ThreadBuffer* buffer = threadBuffers.back().get();
+		buffer->id = static_cast<uint32_t>(threadBuffers.size());
+		buffer->name = "Thread " + std::to_string(buffer->id);
+
+		return buffer;
+	}
+
+	ThreadBuffer& getThreadBuffer()
+	{
+		if (!localBuffer)
+		{
+			std::lock_guard<std::mutex> lock(registryMutex);
+
+			localBuffer = addBuffer();
+		}
+
+		return *localBuffer;
+	}
+
+	void push(ThreadBuffer& buffer, const char* name, int64_t start, int64_t end)
+	{
+		const uint64_t head = buffer.head.load(std::memory_order_relaxed);
+		const uint64_t tail = buffer.tail.load(std::memory_order_acquire);
+
+		// Never block the instrumented thread, if the consumer fell behind the event is lost
+		if (head - tail >= ringCapacity)
+		{
+			buffer.dropped.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+
+		buffer.events[head % ringCapacity] = { name, start, end - start };
+		buffer.head.store(head + 1, std::memory_order_release);
+	}
+
+	void writeEscaped(std::ostream& os, const char* str)
+	{
+		for (; *str; ++str)
+		{
+			if (*str == '"' || *str == '\\')
+			{
+				os << '\\';
+			}
+
+			os << *str;
+		}
+	}
+}
+
+int64_t Profiler::now()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+}
+
+void Profiler::setThreadName(const std::string& name)
+{
+	ThreadBuffer& buffer = getThreadBuffer();
+
+	std::lock_guard<std::mutex> lock(registryMutex);
+	buffer.name = name;
+}
+
+void Profiler::record(const char* name, int64_t start, int64_t end)
+{
+	push(getThreadBuffer(), name, start, end);
+}
+
+uint32_t Profiler::createTrack(const std::string& name, const char* category)
+{
+	std::lock_guard<std::mutex> lock(registryMutex);
+
+	ThreadBuffer* buffer = addBuffer();
+	buffer->name = name;
+	buffer->category = category;
+
+	return buffer->id;
+}
+
+void Profiler::record(uint32_t track, const char* name, int64_t start, int64_t end)
+{
+	ThreadBuffer* buffer = nullptr;
+	{
+		// The registry only grows, so the pointer stays valid once looked up
+		std::lock_guard<std::mutex> lock(registryMutex);
+		buffer = threadBuffers[track - 1].get();
+	}
+
+	push(*buffer, name, start, end);
+}
+
+void Profiler::beginCapture()
+{
+	// Throw away anything left over from before the capture started
+	capturing.store(false);
+	flush();
+
+	std::lock_guard<std::mutex> lock(captureMutex);
+	capturedEvents.clear();
+	capturedDropped = 0;
+
+	capturing.store(true);
+}
+
+void Profiler::endCapture()
+{
+	capturing.store(false);
+	flush();
+}
+
+void Profiler::flush()
+{
+	const bool keep = isCapturing();
+
+	std::lock_guard<std::mutex> registryLock(registryMutex);
+	std::lock_guard<std::mutex> captureLock(captureMutex);
+
+	for (auto& buffer : threadBuffers)
+	{
+		const uint64_t tail = buffer->tail.load(std::memory_order_relaxed);
+		const uint64_t head = buffer->head.load(std::memory_order_acquire);
+
+		if (keep)
+		{
+			for (uint64_t i = tail; i < head; ++i)
+			{
+				capturedEvents.push_back({ buffer->events[i % ringCapacity], buffer->id, buffer->category });
+			}
+
+			capturedDropped += buffer->dropped.exchange(0, std::memory_order_relaxed);
+		}
+
+		buffer->tail.store(head, std::memory_order_release);
+	}
+}
+
+bool Profiler::exportChromeTrace(const std::string& filename)
+{
+	std::ofstream file(filename.c_str(), std::ios_base::binary);
+
+	if (!file)
+	{
+		std::cout << "Failed to open trace file: " << filename << std::endl;
+		return false;
+	}
+
+	std::lock_guard<std::mutex> registryLock(registryMutex);
+	std::lock_guard<std::mutex> captureLock(captureMutex);
+
+	file << std::fixed << std::setprecision(3);
+	file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+
+	bool first = true;
+
+	for (auto& buffer : threadBuffers)
+	{
+		file << (first ? "" : ",\n");
+		file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->id << ",\"args\":{\"name\":\"";
+		writeEscaped(file, buffer->name.c_str());
+		file << "\"}}";
+
+		first = false;
+	}
+
+	for (auto& captured : capturedEvents)
+	{
+		file << (first ? "" : ",\n");
+		file << "{\"name\":\"";
+		writeEscaped(file, captured.event.name);
+		file << "\",\"cat\":\"" << captured.category << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << captured.thread
+			<< ",\"ts\":" << captured.event.start / 1000.0
+			<< ",\"dur\":" << captured.event.duration / 1000.0 << "}";
+
+		first = false;
+	}
+
+	file << "\n]}\n";
+
+	std::cout << "\nWrote " << capturedEvents.size() << " profiler events to " << filename;
+
+	if (capturedDropped > 0)
+	{
+		std::cout << " (" << capturedDropped << " dropped, ring buffer full)";
+	}
+
+	std::cout << std::endl;
+
+	return true;
+}
\ No newline at end of file
@@ -0,0 +1,93 @@
+#pragma once
+
+// Set ONYX_PROFILING to 0 in the preprocessor definitions to compile every
+// profiling scope out of the build
+#ifndef ONYX_PROFILING
+#define ONYX_PROFILING 1
+#endif
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+namespace Profiler
+{
+	struct Event
+	{
+		const char* name;	///< Must point at a string with static storage (literals, __FUNCTION__)
+		int64_t start;		///< Nanoseconds since the profiler epoch
+		int64_t duration;	///< Nanoseconds
+	};
+
+	extern std::atomic<bool> capturing;
+
+	inline bool isCapturing()
+	{
+		return capturing.load(std::memory_order_relaxed);
+	}
+
+	// Nanoseconds since the profiler epoch
+	int64_t now();
+
+	void setThreadName(const std::string& name);
+
+	// Push a finished scope into the calling thread's ring buffer
+	void record(const char* name, int64_t start, int64_t end);
+
+	// Create a named timeline that isn't tied to an OS thread, e.g. the GPU. Only
+	// one thread may record onto a given track
+	uint32_t createTrack(const std::string& name, const char* category);
+
+	void record(uint32_t track, const char* name, int64_t start, int64_t end);
+
+	void beginCapture();
+
+	void endCapture();
+
+	// Drain every thread's ring buffer into the current capture, call once per frame
+	// so the rings never fill up during long captures
+	void flush();
+
+	// Write the last capture as Chrome trace_event JSON (chrome://tracing, Perfetto)
+	bool exportChromeTrace(const std::string& filename);
+
+	class Scope
+	{
+	public:
+
+		explicit Scope(const char* name)
+			:
+			m_name(name),
+			m_start(isCapturing() ? now() : -1)
+		{}
+
+		~Scope()
+		{
+			if (m_start >= 0)
+			{
+				record(m_name, m_start, now());
+			}
+		}
+
+		Scope(const Scope&) = delete;
+
+		Scope& operator=(const Scope&) = delete;
+
+	private:
+
+		const char* m_name;
+		int64_t m_start;
+	};
+}
+
+#if ONYX_PROFILING
+#define PROFILE_CONCAT_IMPL(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_IMPL(a, b)
+#define PROFILE_SCOPE(name) Profiler::Scope PROFILE_CONCAT(profileScope, __LINE__)(name)
+#define PROFILE_FUNCTION() PROFILE_SCOPE(__FUNCTION__)
+#define PROFILE_THREAD(name) Profiler::setThreadName(name)
+#else
+#define PROFILE_SCOPE(name)
+#define PROFILE_FUNCTION()
+#define PROFILE_THREAD(name)
+#endif
\ No newline at end of file
@@ -4,22 +4,44 @@
 #include "SFML\Window\Event.hpp"
 
 void Camera::init(sf::Window* w)
+{
+	init(w->getSize().x, w->getSize().y);
+
+	m_window = w;
+}
+
+void Camera::init(unsigned int width, unsigned int height)
 {
 	mouseClipped = false;
 
 	m_fov = degrees(70.0f);
-	m_aspect = static_cast<float>(w->getSize().x) / static_cast<float>(w->getSize().y);
+	m_aspect = static_cast<float>(width) / static_cast<float>(height);
 	m_nearPlaneDistance = 0.1f;
 	m_farPlaneDistance = 1000.0f;
 
-	m_window = w;
+	m_window = nullptr;
 
-	m_projection.InitPerspective(m_fov.asRadians(), m_aspect, m_nearPlaneDistance, m_farPlaneDistance);
+	m_interpolation = 1.0f;
+
+	m_viewNeedUpdate = true;
+	m_projectionNeedUpdate = true;
 }
 
 void Camera::handleEvent(const sf::Event& event, const sf::Time& dt)
 {
-	if (event.type == sf::Event::MouseButtonPressed)
+	if (!m_window)
+	{
+		return;
+	}
+
+	if (event.type == sf::Event::Resized)
+	{
+		if (event.size.height > 0)
+		{
+			setAspectRatio(static_cast<float>(event.size.width) / static_cast<float>(event.size.height));
+		}
+	}
+	else if (event.type == sf::Event::MouseButtonPressed)
 	{
 		if (event.mouseButton.button == sf::Mouse::Left)
 		{
@@ -57,39 +79,165 @@ void Camera::handleEvent(const sf::Event& event, const sf::Time& dt)
 	}
 }
 
-void Camera::Update(const sf::Time& dt)
+void Camera::Update(const InputState& input, const sf::Time& dt)
 {
 	float mult = 1.0f;
 
-	if (sf::Keyboard::isKeyPressed(sf::Keyboard::LShift))
+	if (input.isKeyPressed(sf::Keyboard::LShift))
 	{
 		mult = 3.0f;
 	}
-	if (sf::Keyboard::isKeyPressed(sf::Keyboard::LControl))
+	if (input.isKeyPressed(sf::Keyboard::LControl))
 	{
 		mult = 0.33f;
 	}
 
 	float movAmt = static_cast<float>(dt.asSeconds()) * mult;
 
-	if (sf::Keyboard::isKeyPressed(sf::Keyboard::Space))
+	if (input.isKeyPressed(sf::Keyboard::Space))
 	{
 		move(Vector3f(0, 1, 0) * movAmt);
 	}
-	if (sf::Keyboard::isKeyPressed(sf::Keyboard::W))
+	if (input.isKeyPressed(sf::Keyboard::W))
 	{
 		move(getRotation().GetForward() * movAmt);
 	}
-	if (sf::Keyboard::isKeyPressed(sf::Keyboard::S))
+	if (input.isKeyPressed(sf::Keyboard::S))
 	{
 		move(getRotation().GetBack() * movAmt);
 	}
-	if (sf::Keyboard::isKeyPressed(sf::Keyboard::A))
+	if (input.isKeyPressed(sf::Keyboard::A))
 	{
 		move(getRotation().GetLeft() * movAmt);
 	}
-	if (sf::Keyboard::isKeyPressed(sf::Keyboard::D))
+	if (input.isKeyPressed(sf::Keyboard::D))
 	{
 		move(getRotation().GetRight() * movAmt);
 	}
+}
+
+void Camera::setFOV(Angle fov)
+{
+	m_fov = fov;
+	m_projectionNeedUpdate = true;
+}
+
+void Camera::setAspectRatio(float aspect)
+{
+	m_aspect = aspect;
+	m_projectionNeedUpdate = true;
+}
+
+void Camera::setClippingDistances(float nearDistance, float farDistance)
+{
+	m_nearPlaneDistance = nearDistance;
+	m_farPlaneDistance = farDistance;
+	m_projectionNeedUpdate = true;
+}
+
+const Matrix4f& Camera::getView() const
+{
+	updateView();
+
+	return m_view;
+}
+
+const Matrix4f& Camera::getProjection() const
+{
+	updateProjection();
+
+	return m_projection;
+}
+
+const Matrix4f& Camera::getViewProjection() const
+{
+	updateView();
+	updateProjection();
+
+	if (m_viewProjectionNeedUpdate)
+	{
+		m_viewProjection = m_projection * m_view;
+		m_viewProjectionNeedUpdate = false;
+	}
+
+	return m_viewProjection;
+}
+
+const Matrix4f& Camera::getInverseView() const
+{
+	updateView();
+
+	return m_inverseView;
+}
+
+const Matrix4f& Camera::getInverseProjection() const
+{
+	updateProjection();
+
+	if (m_inverseProjectionNeedUpdate)
+	{
+		m_inverseProjection = m_projection.Inverse();
+		m_inverseProjectionNeedUpdate = false;
+	}
+
+	return m_inverseProjection;
+}
+
+const Matrix4f& Camera::getInverseViewProjection() const
+{
+	updateView();
+	updateProjection();
+
+	if (m_inverseViewProjectionNeedUpdate)
+	{
+		m_inverseViewProjection = getInverseView() * getInverseProjection();
+		m_inverseViewProjectionNeedUpdate = false;
+	}
+
+	return m_inverseViewProjection;
+}
+
+void Camera::updateView() const
+{
+	// Transform doesn't tell us when it changes and the interpolation moves the
+	// render pose between ticks, so compare against the pose we last built from
+	Vector3f position = getRenderPosition();
+	Quaternion rotation = getRenderRotation();
+
+	if (!m_viewNeedUpdate && position == m_viewPosition && rotation == m_viewRotation)
+	{
+		return;
+	}
+
+	m_viewPosition = position;
+	m_viewRotation = rotation;
+
+	// The translation is inverted because the world appears to move opposite
+	// to the camera's movement.
+	Matrix4f cameraRotation = rotation.Conjugate().ToRotationMatrix();
+	Matrix4f cameraTranslation = Matrix4f().InitTranslation(position.inverted());
+
+	m_view = cameraRotation * cameraTranslation;
+
+	// The view is a rigid transform so its inverse is just the original pose
+	m_inverseView = Matrix4f().InitTranslation(position) * rotation.ToRotationMatrix();
+
+	m_viewNeedUpdate = false;
+	m_viewProjectionNeedUpdate = true;
+	m_inverseViewProjectionNeedUpdate = true;
+}
+
+void Camera::updateProjection() const
+{
+	if (!m_projectionNeedUpdate)
+	{
+		return;
+	}
+
+	m_projection.InitPerspective(m_fov.asRadians(), m_aspect, m_nearPlaneDistance, m_farPlaneDistance);
+
+	m_projectionNeedUpdate = false;
+	m_inverseProjectionNeedUpdate = true;
+	m_viewProjectionNeedUpdate = true;
+	m_inverseViewProjectionNeedUpdate = true;
 }
\ No newline at end of file
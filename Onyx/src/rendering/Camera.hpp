@@ -6,6 +6,8 @@
 
 #include "Transform.hpp"
 
+#include "..\input\InputState.hpp"
+
 namespace sf
 {
 	class Window;
@@ -19,9 +21,12 @@ public:
 
 	void init(sf::Window* w);
 
+	// Initialise without a window, e.g. when rendering offscreen
+	void init(unsigned int width, unsigned int height);
+
 	void handleEvent(const sf::Event& event, const sf::Time& dt);
 
-	void Update(const sf::Time& dt);
+	void Update(const InputState& input, const sf::Time& dt);
 
 	bool isEngaged() const
 	{
@@ -55,17 +60,50 @@ public:
 		return m_aspect;
 	}
 	
-	Matrix4f getProjection() const
+	// Snapshot the transform at the start of an update tick so rendering can
+	// blend between the last two ticks
+	void storePreviousState()
 	{
-		Matrix4f cameraRotation = getRotation().Conjugate().ToRotationMatrix();
+		m_previousPosition = getPosition();
+		m_previousRotation = getRotation();
+	}
 
-		// The translation is inverted because the world appears to move opposite
-		// to the camera's movement.
-		Matrix4f cameraTranslation = Matrix4f().InitTranslation(getPosition().inverted());
+	void setInterpolation(float alpha)
+	{
+		m_interpolation = alpha;
+	}
 
-		return m_projection * cameraRotation * cameraTranslation;
+	Vector3f getRenderPosition() const
+	{
+		return m_previousPosition.Lerp(getPosition(), m_interpolation);
 	}
 
+	Quaternion getRenderRotation() const
+	{
+		return m_previousRotation.NLerp(getRotation(), m_interpolation, true);
+	}
+
+	void setFOV(Angle fov);
+
+	void setAspectRatio(float aspect);
+
+	void setClippingDistances(float nearDistance, float farDistance);
+
+	// The matrices below are cached and only rebuilt when the render pose or the
+	// projection parameters change, so they can be fetched freely while drawing
+
+	const Matrix4f& getView() const;
+
+	const Matrix4f& getProjection() const;
+
+	const Matrix4f& getViewProjection() const;
+
+	const Matrix4f& getInverseView() const;
+
+	const Matrix4f& getInverseProjection() const;
+
+	const Matrix4f& getInverseViewProjection() const;
+
 private:
 
 	bool mouseClipped;
@@ -75,7 +113,28 @@ private:
 	float m_nearPlaneDistance;
 	float m_farPlaneDistance;
 
+	Vector3f m_previousPosition;
+	Quaternion m_previousRotation;
+	float m_interpolation;
+
 	sf::Window*	m_window;
 
+	void updateView() const;
+	void updateProjection() const;
+
+	mutable Vector3f m_viewPosition;				///< Render pose the view matrix was built from
+	mutable Quaternion m_viewRotation;
+
+	mutable Matrix4f m_view;
 	mutable Matrix4f m_projection;
+	mutable Matrix4f m_viewProjection;
+	mutable Matrix4f m_inverseView;
+	mutable Matrix4f m_inverseProjection;
+	mutable Matrix4f m_inverseViewProjection;
+
+	mutable bool m_viewNeedUpdate;
+	mutable bool m_projectionNeedUpdate;
+	mutable bool m_viewProjectionNeedUpdate;
+	mutable bool m_inverseProjectionNeedUpdate;
+	mutable bool m_inverseViewProjectionNeedUpdate;
 };
\ No newline at end of file
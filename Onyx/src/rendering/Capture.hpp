@@ -4,6 +4,10 @@
 
 #include "GL\glew.h"
 
+#include "profiling\GpuProfiler.hpp"
+
+#include "jobs\JobSystem.hpp"
+
 class Capture
 {
 public:
@@ -35,7 +39,9 @@ public:
 		// open pipe to ffmpeg's stdin in binary write mode
 		ffmpeg = _popen(cmd, "wb");
 
-		m_buffer = new uint32_t[m_width*m_height];
+		m_buffers[0] = new uint32_t[m_width*m_height];
+		m_buffers[1] = new uint32_t[m_width*m_height];
+		m_current = 0;
 
 		m_open = true;
 	}
@@ -44,9 +50,37 @@ public:
 	{
 		if (m_open)
 		{
-			glReadPixels(0, 0, m_width, m_height, GL_RGBA, GL_UNSIGNED_BYTE, m_buffer);
+			GPU_PROFILE_SCOPE("Capture readback");
+
+			// Writing to the pipe blocks whenever ffmpeg falls behind, so it's done
+			// on a worker. Two buffers let one frame be written while the next is
+			// read back, this one can't be reused until its last write is done
+			if (m_writes[m_current])
+			{
+				JobSystem::wait(m_writes[m_current]);
+			}
+
+			uint32_t* buffer = m_buffers[m_current];
+
+			glReadPixels(0, 0, m_width, m_height, GL_RGBA, GL_UNSIGNED_BYTE, buffer);
+
+			FILE* pipe = ffmpeg;
+			const std::size_t size = sizeof(uint32_t)*m_width*m_height;
+
+			JobSystem::Handle write = JobSystem::create([pipe, buffer, size]() { fwrite(buffer, size, 1, pipe); });
 
-			fwrite(m_buffer, sizeof(uint32_t)*m_width*m_height, 1, ffmpeg);
+			// Frames have to reach the pipe in order
+			if (m_lastWrite)
+			{
+				JobSystem::addDependency(write, m_lastWrite);
+			}
+
+			JobSystem::run(write);
+
+			m_writes[m_current] = write;
+			m_lastWrite = write;
+
+			m_current ^= 1;
 		}
 	}
 
@@ -54,9 +88,21 @@ public:
 	{
 		if (m_open)
 		{
+			if (m_lastWrite)
+			{
+				JobSystem::wait(m_lastWrite);
+			}
+
 			_pclose(ffmpeg);
 
-			delete m_buffer;
+			delete[] m_buffers[0];
+			delete[] m_buffers[1];
+
+			m_writes[0].reset();
+			m_writes[1].reset();
+			m_lastWrite.reset();
+
+			m_open = false;
 		}
 	}
 
@@ -69,5 +115,9 @@ private:
 	int m_width;
 	int m_height;
 
-	uint32_t* m_buffer;
+	uint32_t* m_buffers[2];
+	int m_current;
+
+	JobSystem::Handle m_writes[2];		///< The last write from each buffer
+	JobSystem::Handle m_lastWrite;
 };
\ No newline at end of file
@@ -3,7 +3,9 @@
 #include "Transform.hpp"
 #include "Mesh.hpp"
 #include "Camera.hpp"
-#include "Shader.hpp"
+#include "ShaderVariants.hpp"
+
+#include "profiling\GpuProfiler.hpp"
 
 #include "math\Rect.hpp"
 
@@ -41,15 +43,6 @@ public:
 		append(Vector2f(m_bounds.right, m_bounds.top));
 
 		m_mesh->complete();
-
-		m_mesh->bind();
-		// Vertex Positions
-		glEnableVertexAttribArray(0);
-		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), NULL);
-		// Vertex Normals
-		glEnableVertexAttribArray(1);
-		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)offsetof(Vertex, normal));
-		m_mesh->unbind();
 	}
 
 	void append(Vector2f position)
@@ -58,23 +51,26 @@ public:
 		m_mesh->addIndex(m_mesh->getSize()-1);
 	}
 
-	void render(Shader& shader, Camera& camera)
+	void render(ShaderVariants& shaders, Camera& camera)
 	{
+		Shader& shader = shaders.get(ShaderFeature::Fade);
+
 		// shader parameters
 		shader.setUniform("objectColour", 0.4f, 0.4f, 0.4f);
 		shader.setUniform("lightColour", 1.0f, 1.0f, 1.0f);
 		shader.setUniform("lightPos", 0.5f, 20.0f, 0.5f);
-		shader.setUniform("viewPos", camera.getPosition());
-		shader.setUniform("fade", 1.0f);
-		shader.setUniform("wireframe", 1.0f);
+		shader.setUniform("viewPos", camera.getRenderPosition());
 
 		// Pass the matrices to the shader
 		shader.setUniform("modelViewMatrix", getTransform());
-		shader.setUniform("projectionMatrix", camera.getProjection());
+		shader.setUniform("modelViewProjectionMatrix", camera.getViewProjection() * getTransform());
+		shader.setUniform("normalMatrix", getInverseTransform().Transpose());
 
 		shader.bind();
 
 		// Draw mesh
+		GPU_PROFILE_SCOPE("Ground::render");
+
 		m_mesh->draw(false);
 	}
 
@@ -0,0 +1,220 @@
+#include "IndirectRenderer.hpp"
+
+#include "Model.hpp"
+#include "Camera.hpp"
+#include "MeshPool.hpp"
+#include "ShaderVariants.hpp"
+
+#include "profiling\Profiler.hpp"
+#include "profiling\GpuProfiler.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+static_assert(sizeof(Matrix4f) == 16 * sizeof(float), "Matrix4f must be tightly packed to be copied to the GPU");
+
+namespace
+{
+	// Array sizes stay a multiple of this so each region of the draw data
+	// buffer is aligned for glBindBufferRange, 256 * 144 byte entries is a
+	// multiple of 256
+	const std::size_t minimumCapacity = 256;
+}
+
+IndirectRenderer::IndirectRenderer()
+	:
+	m_clusterCulling(true),
+	m_clustersTested(0),
+	m_clustersVisible(0)
+{
+}
+
+void IndirectRenderer::setClusterCulling(bool culling)
+{
+	m_clusterCulling = culling;
+}
+
+void IndirectRenderer::render(const std::vector<Model>& models, ShaderVariants& shaders, Camera& camera, unsigned int features)
+{
+	PROFILE_FUNCTION();
+
+	std::vector<const Model*> fallback;
+	std::size_t commands = 0;
+	std::size_t draws = 0;
+	std::size_t primitives = 0;
+
+	m_clustersTested = 0;
+	m_clustersVisible = 0;
+
+	{
+		PROFILE_SCOPE("Build draw commands");
+
+		for (auto& model : models)
+		{
+			Mesh::Ptr mesh = model.getMesh();
+
+			if (!mesh || !mesh->isUploaded())
+			{
+				continue;
+			}
+
+			// Draws find their data through the pool's draw ID buffer, past its
+			// end they'd pick up another model's transform, so any more are
+			// drawn one at a time
+			if (!mesh->isPooled() || mesh->getPrimitiveType() != GL_TRIANGLES || draws == MeshPool::MaxDrawIds)
+			{
+				fallback.push_back(&model);
+				continue;
+			}
+
+			const MeshPool::Range& range = mesh->getPoolRange();
+			const MeshClusters* clusters = mesh->getClusters();
+
+			if (clusters && m_clusterCulling)
+			{
+				// Cull in model space, the camera is taken there with the inverse transform
+				m_visible.clear();
+
+				clusters->cull(camera.getViewProjection() * model.getTransform(),
+					model.getInverseTransform().transformPointAffine(camera.getRenderPosition()), true, m_visible);
+
+				m_clustersTested += clusters->getClusterCount();
+				m_clustersVisible += m_visible.size();
+
+				if (m_visible.empty())
+				{
+					continue;
+				}
+
+				// Every cluster of the model shares its draw data
+				for (auto index : m_visible)
+				{
+					const MeshClusters::Cluster& cluster = (*clusters)[index];
+
+					DrawCommand& command = addCommand(commands);
+					command.count = cluster.indexCount;
+					command.instanceCount = 1;
+					command.firstIndex = range.firstIndex + cluster.firstIndex;
+					command.baseVertex = range.baseVertex;
+					command.baseInstance = static_cast<GLuint>(draws);
+
+					primitives += cluster.indexCount / 3;
+				}
+			}
+			else
+			{
+				DrawCommand& command = addCommand(commands);
+				command.count = range.indexCount;
+				command.instanceCount = 1;
+				command.firstIndex = range.firstIndex;
+				command.baseVertex = range.baseVertex;
+				command.baseInstance = static_cast<GLuint>(draws);
+
+				primitives += range.indexCount / 3;
+			}
+
+			const Vector3f colour = model.getColour();
+
+			DrawData& draw = addDraw(draws);
+			draw.modelMatrix = model.getTransform();
+			draw.normalMatrix = model.getInverseTransform().Transpose();
+			draw.colour[0] = colour.x;
+			draw.colour[1] = colour.y;
+			draw.colour[2] = colour.z;
+			draw.colour[3] = 1.0f;
+		}
+	}
+
+	if (commands > 0)
+	{
+		updateBuffers();
+
+		m_commandBuffer->stream(m_commands.data(), 0, commands * sizeof(DrawCommand));
+		m_drawBuffer->stream(m_draws.data(), 0, draws * sizeof(DrawData));
+
+		Shader& shader = shaders.get(features | ShaderFeature::Indirect);
+
+		shader.setUniform("lightColour", 1.0f, 1.0f, 1.0f);
+		shader.setUniform("lightPos", 0.5f, 1.1f, 0.8f);
+		shader.setUniform("viewPos", camera.getRenderPosition());
+		shader.setUniform("viewProjectionMatrix", camera.getViewProjection());
+
+		shader.bind();
+
+		GPU_PROFILE_SCOPE("IndirectRenderer::render");
+
+		MeshPool::instance().bind();
+
+		m_commandBuffer->bind();
+
+		glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 0, m_drawBuffer->name(), m_drawBuffer->regionOffset(), draws * sizeof(DrawData));
+
+		glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT,
+			reinterpret_cast<const GLvoid*>(m_commandBuffer->regionOffset()), static_cast<GLsizei>(commands), 0);
+
+		m_commandBuffer->unbind();
+
+		m_commandBuffer->fence();
+		m_drawBuffer->fence();
+
+		Mesh::addStatistics(1, draws, primitives);
+	}
+
+	for (auto model : fallback)
+	{
+		model->render(shaders, camera, false, features);
+	}
+}
+
+std::size_t IndirectRenderer::getClustersTested() const
+{
+	return m_clustersTested;
+}
+
+std::size_t IndirectRenderer::getClustersVisible() const
+{
+	return m_clustersVisible;
+}
+
+IndirectRenderer::DrawCommand& IndirectRenderer::addCommand(std::size_t& count)
+{
+	// The arrays only ever grow, so anything the streamed buffers still need
+	// to copy from earlier frames stays in range
+	if (count == m_commands.size())
+	{
+		m_commands.resize(std::max(m_commands.size() * 2, minimumCapacity));
+	}
+
+	return m_commands[count++];
+}
+
+IndirectRenderer::DrawData& IndirectRenderer::addDraw(std::size_t& count)
+{
+	assert(count < MeshPool::MaxDrawIds);
+
+	if (count == m_draws.size())
+	{
+		m_draws.resize(std::max(m_draws.size() * 2, minimumCapacity));
+	}
+
+	return m_draws[count++];
+}
+
+void IndirectRenderer::updateBuffers()
+{
+	if (!m_commandBuffer)
+	{
+		m_commandBuffer.reset(new VBO(GL_DRAW_INDIRECT_BUFFER, GL_STREAM_DRAW));
+		m_drawBuffer.reset(new VBO(GL_SHADER_STORAGE_BUFFER, GL_STREAM_DRAW));
+	}
+
+	// Grow the GPU side to match the arrays
+	if (static_cast<std::size_t>(m_commandBuffer->size()) < m_commands.size() * sizeof(DrawCommand))
+	{
+		m_commandBuffer->storage(m_commands.size() * sizeof(DrawCommand), nullptr);
+	}
+	if (static_cast<std::size_t>(m_drawBuffer->size()) < m_draws.size() * sizeof(DrawData))
+	{
+		m_drawBuffer->storage(m_draws.size() * sizeof(DrawData), nullptr);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "GL\glew.h"
+
+#include "buffers\VBO.hpp"
+
+#include "math\Matrix.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+class Model;
+class Camera;
+class ShaderVariants;
+
+// Draws every pooled model with a single glMultiDrawElementsIndirect. The
+// draw commands (one per visible cluster for clustered meshes) and each
+// model's transform and colour are rebuilt per frame into streamed buffers,
+// and the shader finds its draw's data through the draw index attribute set
+// up by MeshPool
+class IndirectRenderer
+{
+public:
+
+	IndirectRenderer();
+
+	// Models that aren't in the MeshPool or aren't triangles fall back to
+	// Model::render, as do any beyond MeshPool::MaxDrawIds
+	void render(const std::vector<Model>& models, ShaderVariants& shaders, Camera& camera, unsigned int features = 0);
+
+	// Clustered meshes get a draw per cluster that survives frustum and
+	// backface cone culling rather than a draw for the whole mesh
+	void setClusterCulling(bool culling);
+
+	// Clusters considered and drawn in the last render
+	std::size_t getClustersTested() const;
+
+	std::size_t getClustersVisible() const;
+
+private:
+
+	struct DrawCommand
+	{
+		GLuint count;
+		GLuint instanceCount;
+		GLuint firstIndex;
+		GLint baseVertex;
+		GLuint baseInstance;
+	};
+
+	// Matches DrawData in model.vert with std430 layout
+	struct DrawData
+	{
+		Matrix4f modelMatrix;
+		Matrix4f normalMatrix;
+		float colour[4];
+	};
+
+	DrawCommand& addCommand(std::size_t& count);
+
+	DrawData& addDraw(std::size_t& count);
+
+	void updateBuffers();
+
+	bool m_clusterCulling;
+
+	std::size_t m_clustersTested;
+	std::size_t m_clustersVisible;
+
+	std::vector<uint32_t> m_visible;
+
+	std::vector<DrawCommand> m_commands;
+	std::vector<DrawData> m_draws;
+
+	// Created on first use, the renderer is constructed before the GL context
+	std::unique_ptr<VBO> m_commandBuffer;
+	std::unique_ptr<VBO> m_drawBuffer;
+};
\ No newline at end of file
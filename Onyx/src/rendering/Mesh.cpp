@@ -1,18 +1,51 @@
 
 #include "Mesh.hpp"
 
+#include "profiling\Profiler.hpp"
+
+#include "jobs\JobSystem.hpp"
+
+#include <cstddef>
+#include <iostream>
+
+namespace
+{
+	// Enough work per job to outweigh scheduling it
+	const std::size_t verticesPerJob = 1 << 16;
+	const std::size_t trianglesPerJob = 1 << 15;
+}
+
+unsigned int Mesh::s_drawCalls = 0;
+std::size_t Mesh::s_meshes = 0;
+std::size_t Mesh::s_primitives = 0;
+
 Mesh::Mesh(size_t size)
 	:
-	m_verticesBuffer(GL_ARRAY_BUFFER, GL_STATIC_DRAW),
-	m_indicesBuffer(GL_ELEMENT_ARRAY_BUFFER, GL_STATIC_DRAW),
-	m_mode(GL_TRIANGLES)
+	m_vao(0),
+	m_mode(GL_TRIANGLES),
+	m_streaming(false),
+	m_poolHandle(MeshPool::InvalidHandle),
+	m_residency(Residency::CpuAndGpu),
+	m_released(false),
+	m_pins(0),
+	m_releasePending(false),
+	m_releasedVertices(0),
+	m_releasedIndices(0)
 {
 	resize(size);
 }
 
 Mesh::~Mesh()
 {
-	glDeleteVertexArrays(1, &m_vao);
+	if (isPooled())
+	{
+		MeshPool::instance().free(m_poolHandle);
+	}
+
+	if (m_vao != 0)
+	{
+		glDeleteVertexArrays(1, &m_vao);
+	}
 }
 
 Mesh::Ptr Mesh::create(size_t size)
@@ -23,64 +56,434 @@ Mesh::Ptr Mesh::create(size_t size)
 
 void Mesh::resize(size_t size)
 {
+	makeResident();
+	keepEdits();
+
 	m_vertices.resize(size);
 }
 
 void Mesh::clear()
 {
+	keepEdits();
+
 	m_vertices.clear();
 	m_indices.clear();
+
+	m_released = false;
 }
 
 void Mesh::addVertex(const Vertex& vertex)
 {
+	makeResident();
+	keepEdits();
+
 	m_vertices.push_back(vertex);
 }
 
 void Mesh::addIndex(GLuint index)
 {
+	makeResident();
+	keepEdits();
+
 	m_indices.push_back(index);
 }
 
 void Mesh::complete()
 {
-	glGenVertexArrays(1, &m_vao);
-	glBindVertexArray(m_vao);
+	PROFILE_FUNCTION();
+
+	if (m_residency == Residency::CpuOnly)
+	{
+		return;
+	}
+
+	makeResident();
+
+	if (!m_streaming)
+	{
+		if (isPooled())
+		{
+			MeshPool::instance().free(m_poolHandle);
+		}
+
+		m_poolHandle = MeshPool::instance().allocate(m_vertices, m_indices);
+
+		if (m_residency == Residency::GpuOnly)
+		{
+			releaseCpuData();
+		}
+
+		return;
+	}
+
+	MeshPool::bindVertexArray(0);
+
+	if (m_vao == 0)
+	{
+		glGenVertexArrays(1, &m_vao);
+
+		m_verticesBuffer.reset(new VBO(GL_ARRAY_BUFFER, GL_STATIC_DRAW));
+		m_indicesBuffer.reset(new VBO(GL_ELEMENT_ARRAY_BUFFER, GL_STATIC_DRAW));
+	}
+
+	m_verticesBuffer->storage(m_vertices.size() * sizeof(Vertex), m_vertices.data());
+
+	m_indicesBuffer->data(m_indices.size() * sizeof(GLuint), m_indices.data());
+
+	setupAttributes();
+}
+
+void Mesh::setStreaming(bool streaming)
+{
+	m_streaming = streaming;
+}
+
+bool Mesh::isStreaming() const
+{
+	return m_streaming;
+}
+
+bool Mesh::isPooled() const
+{
+	return m_poolHandle != MeshPool::InvalidHandle;
+}
+
+bool Mesh::isUploaded() const
+{
+	return isPooled() || m_vao != 0;
+}
+
+void Mesh::setResidency(Residency residency)
+{
+	m_residency = residency;
+
+	if (m_residency == Residency::GpuOnly)
+	{
+		releaseCpuData();
+	}
+	else
+	{
+		makeResident();
+	}
+}
+
+Mesh::Residency Mesh::getResidency() const
+{
+	return m_residency;
+}
+
+void Mesh::setSource(Source source)
+{
+	std::lock_guard<std::mutex> lock(m_pageMutex);
+
+	m_source = std::move(source);
+}
+
+void Mesh::releaseCpuData()
+{
+	// Only pooled meshes have a copy on the GPU to draw from
+	if (m_streaming || !isPooled() || m_released)
+	{
+		return;
+	}
+
+	PROFILE_FUNCTION();
+
+	// Kept so bounds don't need the vertices paging in
+	const AABBf bounds = getLocalBounds();
+
+	std::lock_guard<std::mutex> lock(m_pageMutex);
+
+	// Without a source the arrays couldn't be paged back in
+	if (!m_source)
+	{
+		return;
+	}
+
+	m_releasedBounds = bounds;
+
+	if (m_pins > 0)
+	{
+		m_releasePending = true;
+		return;
+	}
+
+	freeArrays();
+}
+
+void Mesh::freeArrays() const
+{
+	m_releasedVertices = m_vertices.size();
+	m_releasedIndices = m_indices.size();
+
+	std::vector<Vertex>().swap(m_vertices);
+	std::vector<GLuint>().swap(m_indices);
+
+	m_releasePending = false;
+	m_released = true;
+}
+
+void Mesh::pageIn() const
+{
+	std::lock_guard<std::mutex> lock(m_pageMutex);
+
+	loadReleasedData();
+}
+
+void Mesh::loadReleasedData() const
+{
+	// Another thread may have got here first
+	if (!m_released)
+	{
+		return;
+	}
+
+	PROFILE_FUNCTION();
+
+	std::vector<Vertex> vertices;
+	std::vector<GLuint> indices;
+
+	const bool loaded = m_source && m_source(vertices, indices) &&
+		vertices.size() == m_releasedVertices &&
+		indices.size() == m_releasedIndices;
+
+	// The copy on the GPU still draws, but there's nothing left to read on the
+	// CPU. It can't be read back from here as this may not be the render thread
+	if (!loaded)
+	{
+		std::cout << "Failed to page in a mesh's vertices, its source has changed or gone" << std::endl;
+
+		vertices.clear();
+		indices.clear();
+	}
+
+	m_vertices.swap(vertices);
+	m_indices.swap(indices);
+
+	m_released = false;
+}
+
+void Mesh::pin() const
+{
+	std::lock_guard<std::mutex> lock(m_pageMutex);
+
+	loadReleasedData();
+
+	m_pins++;
+}
+
+void Mesh::unpin() const
+{
+	std::lock_guard<std::mutex> lock(m_pageMutex);
+
+	assert(m_pins > 0);
+
+	if (--m_pins == 0 && m_releasePending)
+	{
+		freeArrays();
+	}
+}
+
+void Mesh::keepEdits()
+{
+	std::lock_guard<std::mutex> lock(m_pageMutex);
+
+	// Without a source the arrays are never freed, so there's nothing to do
+	if (!m_source)
+	{
+		return;
+	}
+
+	// A release deferred by a pin would otherwise throw the edit away
+	m_source = nullptr;
+	m_releasePending = false;
+	m_residency = Residency::CpuAndGpu;
+}
+
+const MeshPool::Range& Mesh::getPoolRange() const
+{
+	return MeshPool::instance().getRange(m_poolHandle);
+}
+
+void Mesh::buildClusters(std::size_t trianglesPerCluster)
+{
+	assert(!isPooled() && m_vao == 0);
 
-	m_verticesBuffer.data(m_vertices.size() * sizeof(Vertex), m_vertices.data());
+	makeResident();
 
-	m_indicesBuffer.data(m_indices.size() * sizeof(GLuint), m_indices.data());
+	if (!m_clusters)
+	{
+		m_clusters.reset(new MeshClusters());
+	}
+
+	m_clusters->build(m_vertices, m_indices, trianglesPerCluster);
+}
+
+const MeshClusters* Mesh::getClusters() const
+{
+	return m_clusters.get();
+}
+
+void Mesh::setClusters(std::unique_ptr<MeshClusters> clusters)
+{
+	assert(!isPooled() && m_vao == 0);
+
+	m_clusters = std::move(clusters);
+}
+
+void Mesh::updateVertices(std::size_t first, std::size_t count)
+{
+	PROFILE_FUNCTION();
+
+	makeResident();
+	keepEdits();
+
+	assert(first + count <= m_vertices.size());
+
+	if (!m_streaming)
+	{
+		// Nothing to update until complete() has put the mesh in the pool, and a
+		// different size needs a new range
+		if (isPooled() && static_cast<std::size_t>(getPoolRange().vertexCount) != m_vertices.size())
+		{
+			complete();
+		}
+		else if (isPooled())
+		{
+			MeshPool::instance().updateVertices(m_poolHandle, first, count, m_vertices.data());
+		}
+
+		return;
+	}
+
+	// Likewise nothing to update before the first complete()
+	if (m_vao == 0)
+	{
+		return;
+	}
+
+	const GLsizeiptr size = m_vertices.size() * sizeof(Vertex);
+
+	if (size != m_verticesBuffer->size())
+	{
+		// Immutable storage has to be recreated, which means a new buffer
+		// object so the vertex array has to be pointed at it again
+		m_verticesBuffer->storage(size, m_vertices.data());
+
+		setupAttributes();
+	}
+	else if (count > 0)
+	{
+		m_verticesBuffer->stream(m_vertices.data(), first * sizeof(Vertex), count * sizeof(Vertex));
+	}
+}
+
+void Mesh::setupAttributes()
+{
+	MeshPool::bindVertexArray(m_vao);
 
 	// keep these bound so only need to bind vao in future
-	m_verticesBuffer.bind();
-	m_indicesBuffer.bind();
+	m_verticesBuffer->bind();
+	m_indicesBuffer->bind();
+
+	// Vertex Positions
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)offsetof(Vertex, position));
+	// Vertex Normals
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)offsetof(Vertex, normal));
 
-	glBindVertexArray(0);
+	MeshPool::bindVertexArray(0);
 }
 
 void Mesh::addVertices(const std::vector<Vertex>& vertices)
 {
+	makeResident();
+	keepEdits();
+
 	m_vertices = vertices;
 }
 
 void Mesh::addIndices(const std::vector<GLuint>& indices)
 {
+	makeResident();
+	keepEdits();
+
 	m_indices = indices;
 }
 
+void Mesh::addVertices(std::vector<Vertex>&& vertices)
+{
+	makeResident();
+	keepEdits();
+
+	m_vertices = std::move(vertices);
+}
+
+void Mesh::addIndices(std::vector<GLuint>&& indices)
+{
+	makeResident();
+	keepEdits();
+
+	m_indices = std::move(indices);
+}
+
 size_t Mesh::getSize() const
 {
-	return m_vertices.size();
+	// The arrays can be freed by another thread's last unpin
+	std::lock_guard<std::mutex> lock(m_pageMutex);
+
+	return m_released ? m_releasedVertices : m_vertices.size();
+}
+
+size_t Mesh::getIndexCount() const
+{
+	std::lock_guard<std::mutex> lock(m_pageMutex);
+
+	return m_released ? m_releasedIndices : m_indices.size();
+}
+
+std::size_t Mesh::getCpuBytes() const
+{
+	std::lock_guard<std::mutex> lock(m_pageMutex);
+
+	return m_vertices.capacity() * sizeof(Vertex) + m_indices.capacity() * sizeof(GLuint);
+}
+
+std::size_t Mesh::getGpuBytes() const
+{
+	if (!isUploaded())
+	{
+		return 0;
+	}
+
+	if (isPooled())
+	{
+		const MeshPool::Range& range = getPoolRange();
+
+		return range.vertexCount * sizeof(Vertex) + range.indexCount * sizeof(GLuint);
+	}
+
+	return 3 * m_vertices.size() * sizeof(Vertex) + m_indices.size() * sizeof(GLuint);
 }
 
 std::vector<Vertex>::const_pointer Mesh::getData() const
 {
+	makeResident();
+
 	return m_vertices.data();
 }
 
+std::vector<GLuint>::const_pointer Mesh::getIndexData() const
+{
+	makeResident();
+
+	return m_indices.data();
+}
+
 bool Mesh::isEmpty() const
 {
-	return m_vertices.empty();
+	return getSize() == 0;
 }
 
 void Mesh::setPrimitiveType(GLenum mode)
@@ -88,19 +491,45 @@ void Mesh::setPrimitiveType(GLenum mode)
 	m_mode = mode;
 }
 
+GLenum Mesh::getPrimitiveType() const
+{
+	return m_mode;
+}
+
 float Mesh::getVolume(const Matrix4f& transform) const
 {
-	float volume = 0.0f;
+	PROFILE_FUNCTION();
+
+	const ResidencyPin pin(*this);
 
-	for (int i = 0; i < getSize() / 3; i++)
+	const std::size_t triangles = m_indices.size() / 3;
+
+	// Sum each chunk separately then add the chunks up in order, so the
+	// result doesn't depend on how the chunks were scheduled
+	std::vector<float> volumes(JobSystem::chunkCount(triangles, trianglesPerJob), 0.0f);
+
+	JobSystem::parallelFor(0, triangles, trianglesPerJob, [&](std::size_t first, std::size_t last)
 	{
-		Triangle tri = getTriangle(i);
+		float volume = 0.0f;
+
+		for (std::size_t i = first; i < last; i++)
+		{
+			// Read directly rather than with getTriangle(), which pins for every call
+			const Vector3f p0 = transform.transformPoint(m_vertices[m_indices[i * 3 + 0]].position);
+			const Vector3f p1 = transform.transformPoint(m_vertices[m_indices[i * 3 + 1]].position);
+			const Vector3f p2 = transform.transformPoint(m_vertices[m_indices[i * 3 + 2]].position);
+
+			volume += p0.Dot(p1.Cross(p2)) / 6.0f;
+		}
 
-		tri.vert0.position = transform.transformPoint(tri.vert0.position);
-		tri.vert1.position = transform.transformPoint(tri.vert1.position);
-		tri.vert2.position = transform.transformPoint(tri.vert2.position);
+		volumes[first / trianglesPerJob] = volume;
+	});
 
-		volume += tri.vert0.position.Dot(tri.vert1.position.Cross(tri.vert2.position)) / 6.0f;
+	float volume = 0.0f;
+
+	for (auto v : volumes)
+	{
+		volume += v;
 	}
 
 	return std::abs(volume);
@@ -108,23 +537,40 @@ float Mesh::getVolume(const Matrix4f& transform) const
 
 AABBf Mesh::getLocalBounds() const
 {
-	AABBf meshBounds;
+	PROFILE_FUNCTION();
 
-	for (auto&v : m_vertices)
+	if (m_released)
 	{
-		meshBounds.include(v.position);
+		return m_releasedBounds;
 	}
 
-	return meshBounds;
+	return getGlobalBounds(Matrix4f());
 }
 
 AABBf Mesh::getGlobalBounds(const Matrix4f& transform) const
 {
+	PROFILE_FUNCTION();
+
+	const ResidencyPin pin(*this);
+
+	std::vector<AABBf> bounds(JobSystem::chunkCount(m_vertices.size(), verticesPerJob));
+
+	JobSystem::parallelFor(0, m_vertices.size(), verticesPerJob, [&](std::size_t first, std::size_t last)
+	{
+		AABBf& chunkBounds = bounds[first / verticesPerJob];
+
+		for (std::size_t i = first; i < last; i++)
+		{
+			chunkBounds.include(transform.transformPoint(m_vertices[i].position));
+		}
+	});
+
 	AABBf meshBounds;
 
-	for (auto&v : m_vertices)
+	for (auto& chunkBounds : bounds)
 	{
-		meshBounds.include(transform.transformPoint(v.position));
+		meshBounds.include(chunkBounds.min);
+		meshBounds.include(chunkBounds.max);
 	}
 
 	return meshBounds;
@@ -132,6 +578,8 @@ AABBf Mesh::getGlobalBounds(const Matrix4f& transform) const
 
 Triangle Mesh::getTriangle(std::size_t index) const
 {
+	const ResidencyPin pin(*this);
+
 	GLuint i0 = m_indices[index * 3 + 0];
 	GLuint i1 = m_indices[index * 3 + 1];
 	GLuint i2 = m_indices[index * 3 + 2];
@@ -141,47 +589,74 @@ Triangle Mesh::getTriangle(std::size_t index) const
 
 void Mesh::updateNormals()
 {
-	std::vector<Vector3f> normals(m_vertices.size());
+	PROFILE_FUNCTION();
 
-	for (unsigned int i = 0; i < normals.size(); i++)
-	{
-		normals[i] = Vector3f(0.0f, 0.0f, 0.0f);
-	}
+	const ResidencyPin pin(*this);
+
+	keepEdits();
+
+	const std::size_t triangles = m_indices.size() / 3;
 
-	for (unsigned int i = 0; i < m_indices.size(); i += 3)
+	// Face normals in parallel, accumulating them onto shared vertices would
+	// need atomics so that part stays serial
+	std::vector<Vector3f> faceNormals(triangles);
+
+	JobSystem::parallelFor(0, triangles, trianglesPerJob, [&](std::size_t first, std::size_t last)
 	{
-		GLuint i0 = m_indices[i + 0];
-		GLuint i1 = m_indices[i + 1];
-		GLuint i2 = m_indices[i + 2];
+		for (std::size_t t = first; t < last; t++)
+		{
+			GLuint i0 = m_indices[t * 3 + 0];
+			GLuint i1 = m_indices[t * 3 + 1];
+			GLuint i2 = m_indices[t * 3 + 2];
+
+			Vector3f v1 = m_vertices[i1].position - m_vertices[i0].position;
+			Vector3f v2 = m_vertices[i2].position - m_vertices[i0].position;
 
-		Vector3f v1 = m_vertices[i1].position - m_vertices[i0].position;
-		Vector3f v2 = m_vertices[i2].position - m_vertices[i0].position;
+			faceNormals[t] = v1.Cross(v2).Normalized();
+		}
+	});
 
-		Vector3f normal = v1.Cross(v2).Normalized();
+	std::vector<Vector3f> normals(m_vertices.size(), Vector3f(0.0f, 0.0f, 0.0f));
 
-		normals[i0] += normal;
-		normals[i1] += normal;
-		normals[i2] += normal;
+	for (std::size_t t = 0; t < triangles; t++)
+	{
+		normals[m_indices[t * 3 + 0]] += faceNormals[t];
+		normals[m_indices[t * 3 + 1]] += faceNormals[t];
+		normals[m_indices[t * 3 + 2]] += faceNormals[t];
 	}
 
-	for (unsigned int i = 0; i < normals.size(); i++)
-		m_vertices[i].normal = normals[i].Normalized();
+	JobSystem::parallelFor(0, normals.size(), verticesPerJob, [&](std::size_t first, std::size_t last)
+	{
+		for (std::size_t i = first; i < last; i++)
+		{
+			m_vertices[i].normal = normals[i].Normalized();
+		}
+	});
 
-	m_verticesBuffer.data(m_vertices.size() * sizeof(Vertex), m_vertices.data());
+	updateVertices(0, m_vertices.size());
 }
 
 void Mesh::bind() const
 {
-	glBindVertexArray(m_vao);
+	if (isPooled())
+	{
+		MeshPool::instance().bind();
+	}
+	else
+	{
+		MeshPool::bindVertexArray(m_vao);
+	}
 }
 
 void Mesh::unbind() const
 {
-	glBindVertexArray(0);
+	MeshPool::bindVertexArray(0);
 }
 
 void Mesh::draw(bool wireframe) const
 {
+	PROFILE_FUNCTION();
+
 	bind();
 
 	if (wireframe)
@@ -189,12 +664,67 @@ void Mesh::draw(bool wireframe) const
 		glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
 	}
 
-	glDrawElements(m_mode, m_indices.size(), GL_UNSIGNED_INT, 0);
+	if (isPooled())
+	{
+		const MeshPool::Range& range = getPoolRange();
+
+		glDrawElementsBaseVertex(m_mode, range.indexCount, GL_UNSIGNED_INT,
+			reinterpret_cast<const GLvoid*>(range.firstIndex * sizeof(GLuint)), range.baseVertex);
+	}
+	else
+	{
+		// Streaming meshes read from whichever region was written last
+		const GLint baseVertex = static_cast<GLint>(m_verticesBuffer->regionOffset() / sizeof(Vertex));
+
+		glDrawElementsBaseVertex(m_mode, m_indices.size(), GL_UNSIGNED_INT, 0, baseVertex);
+
+		m_verticesBuffer->fence();
+	}
+
+	s_drawCalls++;
+	s_meshes++;
+	// A GPU-only mesh has freed its indices, the count is kept with the draw
+	const std::size_t indexCount = isPooled() ? static_cast<std::size_t>(getPoolRange().indexCount) : getIndexCount();
+
+	s_primitives += (m_mode == GL_LINES) ? indexCount / 2 : indexCount / 3;
 
 	if (wireframe)
 	{
 		glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
 	}
 
-	unbind();
+	// Pooled meshes share a vertex array, leave it bound for the next one
+	if (!isPooled())
+	{
+		unbind();
+	}
+}
+
+void Mesh::resetStatistics()
+{
+	s_drawCalls = 0;
+	s_meshes = 0;
+	s_primitives = 0;
+}
+
+void Mesh::addStatistics(unsigned int drawCalls, std::size_t meshes, std::size_t primitives)
+{
+	s_drawCalls += drawCalls;
+	s_meshes += meshes;
+	s_primitives += primitives;
+}
+
+unsigned int Mesh::getDrawCalls()
+{
+	return s_drawCalls;
+}
+
+std::size_t Mesh::getMeshesDrawn()
+{
+	return s_meshes;
+}
+
+std::size_t Mesh::getPrimitiveCount()
+{
+	return s_primitives;
 }
\ No newline at end of file
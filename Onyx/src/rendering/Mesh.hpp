@@ -4,9 +4,15 @@
 #include <string>
 #include <cassert>
 #include <memory>
+#include <atomic>
+#include <functional>
+#include <mutex>
 
 #include "buffers\VBO.hpp"
 
+#include "MeshPool.hpp"
+#include "MeshClusters.hpp"
+
 #include "math\Vector.hpp"
 #include "math\AABB.hpp"
 #include "math\Matrix.hpp"
@@ -14,12 +20,55 @@
 #include "Vertex.hpp"
 #include "Triangle.hpp"
 
+// Building a mesh and editing its vertices and indices makes no GL calls, so
+// it can be done on any thread. complete(), updateVertices(), drawing and
+// destroying an uploaded mesh need the GL context and belong to the render
+// thread, see GraphicSystem::upload() and GraphicSystem::release()
 class Mesh
 {
 public:
 
 	typedef std::shared_ptr<Mesh> Ptr;
 
+	// Where the vertices and indices are kept once complete() has run
+	enum class Residency
+	{
+		CpuAndGpu,		///< A copy stays in RAM for queries and edits
+		GpuOnly,		///< RAM is freed after upload and paged back in from the source when needed
+		CpuOnly			///< Never uploaded, for processing meshes without a GL context
+	};
+
+	// Fills in the arrays of a GPU-only mesh exactly as they were uploaded,
+	// returns false if it can't
+	typedef std::function<bool(std::vector<Vertex>& vertices, std::vector<GLuint>& indices)> Source;
+
+	// Keeps the arrays of a GPU-only mesh in RAM for as long as it exists, so
+	// the render thread can't free them while another thread is reading them.
+	// Hold one while using anything that points into the arrays, e.g. getData()
+	// or iterators
+	class ResidencyPin
+	{
+	public:
+
+		explicit ResidencyPin(const Mesh& mesh) : m_mesh(mesh)
+		{
+			m_mesh.pin();
+		}
+
+		~ResidencyPin()
+		{
+			m_mesh.unpin();
+		}
+
+		ResidencyPin(const ResidencyPin& other) = delete;
+
+		ResidencyPin& operator=(const ResidencyPin& other) = delete;
+
+	private:
+
+		const Mesh& m_mesh;
+	};
+
 private:
 
 	Mesh(size_t size = 0);
@@ -35,31 +84,45 @@ public:
 
 	iterator begin()
 	{
+		makeResident();
+
 		return m_vertices.begin();
 	}
 
 	const_iterator begin() const
 	{
+		makeResident();
+
 		return m_vertices.begin();
 	}
 
 	iterator end()
 	{
+		makeResident();
+
 		return m_vertices.end();
 	}
 
 	const_iterator end() const
 	{
+		makeResident();
+
 		return m_vertices.end();
 	}
 
 	inline const Vertex& operator[](int index) const
 	{
+		makeResident();
+
 		return m_vertices[index];
 	}
 
+	// Follow edits with updateVertices(), which keeps them in RAM. Until then
+	// a GPU-only mesh needs a ResidencyPin to hold on to them
 	inline Vertex& operator[](int index)
 	{
+		makeResident();
+
 		return m_vertices[index];
 	}
 
@@ -71,20 +134,95 @@ public:
 
 	void addIndex(GLuint index);
 
+	// Upload the vertices and indices and set up the vertex array
 	void complete();
 
+	// Static meshes live in the shared MeshPool. Streaming meshes keep their
+	// own vertex array with the vertices in a persistently mapped, triple
+	// buffered VBO so they can change every frame without reallocating or
+	// stalling. Must be set before complete()
+	void setStreaming(bool streaming);
+
+	bool isStreaming() const;
+
+	bool isPooled() const;
+
+	// Whether complete() has put the mesh on the GPU so it can be drawn
+	bool isUploaded() const;
+
+	// Streaming meshes are always kept in RAM as they're edited every frame
+	void setResidency(Residency residency);
+
+	Residency getResidency() const;
+
+	// Where a GPU-only mesh is paged back in from, e.g. the mesh cache on disk.
+	// Without one there'd be nowhere to page in from, so the arrays are kept
+	void setSource(Source source);
+
+	// False while a GPU-only mesh has freed its arrays
+	bool isResident() const
+	{
+		return !m_released;
+	}
+
+	// Bring the arrays back into RAM if they've been freed, they then stay in
+	// RAM until the next upload. Enough for the thread building or editing a
+	// mesh, other threads reading it need a ResidencyPin
+	void makeResident() const
+	{
+		if (m_released)
+		{
+			pageIn();
+		}
+	}
+
+	// Split the triangles into clusters that can be culled individually. This
+	// reorders the indices so must be done before complete()
+	void buildClusters(std::size_t trianglesPerCluster = 128);
+
+	// Null unless buildClusters() has been called
+	const MeshClusters* getClusters() const;
+
+	// Use clusters built earlier for these exact indices, e.g. from the mesh cache
+	void setClusters(std::unique_ptr<MeshClusters> clusters);
+
+	// Where the mesh lives in the MeshPool, only valid for pooled meshes
+	const MeshPool::Range& getPoolRange() const;
+
+	// Push a range of changed vertices to the GPU, resizing the buffer if the
+	// mesh has grown. The source no longer matches the arrays after an edit, so
+	// it's dropped and the mesh stays in RAM from then on
+	void updateVertices(std::size_t first, std::size_t count);
+
 	void addVertices(const std::vector<Vertex>& vertices);
 
 	void addIndices(const std::vector<GLuint>& indices);
 
+	void addVertices(std::vector<Vertex>&& vertices);
+
+	void addIndices(std::vector<GLuint>&& indices);
+
 	size_t getSize() const;
 
+	size_t getIndexCount() const;
+
+	// Memory held by the vertex and index arrays in RAM
+	std::size_t getCpuBytes() const;
+
+	// Memory held on the GPU once uploaded, streaming meshes keep three copies
+	// of their vertices
+	std::size_t getGpuBytes() const;
+
 	std::vector<Vertex>::const_pointer getData() const;
 
+	std::vector<GLuint>::const_pointer getIndexData() const;
+
 	bool isEmpty() const;
 
 	void setPrimitiveType(GLenum mode);
 
+	GLenum getPrimitiveType() const;
+
 	float getVolume(const Matrix4f& transform) const;
 
 	AABBf getLocalBounds() const;
@@ -101,15 +239,75 @@ public:
 
 	void draw(bool wireframe = false) const;
 
+	// Draw calls and primitives submitted since the last reset
+	static void resetStatistics();
+
+	// Count draws submitted outside of draw(), e.g. a multi-draw of many meshes
+	static void addStatistics(unsigned int drawCalls, std::size_t meshes, std::size_t primitives);
+
+	static unsigned int getDrawCalls();
+
+	// Meshes drawn, the same as draw calls unless draws were batched
+	static std::size_t getMeshesDrawn();
+
+	static std::size_t getPrimitiveCount();
+
 private:
 
+	void setupAttributes();
+
+	// Free the arrays of an uploaded GPU-only mesh, or once the last pin goes
+	// if any are held
+	void releaseCpuData();
+
+	void pageIn() const;
+
+	// Both need m_pageMutex held
+	void loadReleasedData() const;
+	void freeArrays() const;
+
+	void pin() const;
+	void unpin() const;
+
+	// Called whenever the arrays are edited, so they're never freed with only
+	// a stale source to page them back in from. The mesh stays in RAM
+	void keepEdits();
+
+	static unsigned int s_drawCalls;
+	static std::size_t s_meshes;
+	static std::size_t s_primitives;
+
 	GLuint m_vao;
 	
 	GLenum m_mode;
 
-	VBO m_verticesBuffer;
-	VBO m_indicesBuffer;
+	bool m_streaming;
+
+	MeshPool::Handle m_poolHandle;
+
+	std::unique_ptr<MeshClusters> m_clusters;
+
+	// Only streaming meshes have their own buffers, created by complete()
+	std::unique_ptr<VBO> m_verticesBuffer;
+	std::unique_ptr<VBO> m_indicesBuffer;
+
+	Residency m_residency;
+
+	Source m_source;
+
+	// Paging in only fills the arrays back in, so to the rest of the mesh they
+	// behave as if they'd never left
+	mutable std::vector<GLuint> m_indices;
+	mutable std::vector<Vertex> m_vertices;
+
+	mutable std::mutex m_pageMutex;
+	mutable std::atomic<bool> m_released;
+
+	mutable std::size_t m_pins;				///< ResidencyPins held, under m_pageMutex
+	mutable bool m_releasePending;			///< Released while pinned, the last unpin frees the arrays
 
-	std::vector<GLuint> m_indices;
-	std::vector<Vertex> m_vertices;
+	// What the arrays held when they were freed
+	mutable std::size_t m_releasedVertices;
+	mutable std::size_t m_releasedIndices;
+	AABBf m_releasedBounds;
 };
\ No newline at end of file
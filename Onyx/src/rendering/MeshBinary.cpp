@@ -0,0 +1,397 @@
+#include "MeshBinary.hpp"
+
+#include "profiling\Profiler.hpp"
+
+#include <sys\types.h>
+#include <sys\stat.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <direct.h>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+namespace
+{
+	const char fileMagic[8] = { 'O', 'N', 'Y', 'X', 'M', 'E', 'S', 'H' };
+	const uint32_t fileVersion = 1;
+
+	// Every section starts on a cache line
+	const uint64_t sectionAlignment = 64;
+
+	std::string cacheDirectory = "./meshcache/";
+
+	struct FileHeader
+	{
+		char magic[8];
+		uint32_t version;
+		uint32_t lodCount;
+		uint64_t pathHash;
+		uint64_t importOptions;
+		uint64_t sourceSize;
+		int64_t sourceTime;
+		uint64_t contentHash;
+		uint64_t vertexCount;
+		uint64_t indexCount;
+		uint64_t vertexOffset;
+		uint64_t indexOffset;
+		uint64_t lodOffset;
+		uint64_t clusterOffset;			///< 0 if the mesh has no clusters
+		float boundsMin[3];
+		float boundsMax[3];
+	};
+
+	// A range of the index array, coarser levels follow the full detail one
+	struct LodLevel
+	{
+		uint32_t firstIndex;
+		uint32_t indexCount;
+		float error;					///< Model space distance from the full detail surface
+		uint32_t reserved;
+	};
+
+	uint64_t align(uint64_t offset)
+	{
+		return (offset + sectionAlignment - 1) / sectionAlignment * sectionAlignment;
+	}
+
+	// 64 bit FNV-1a
+	void hash(uint64_t& h, const char* data, std::size_t size)
+	{
+		for (std::size_t i = 0; i < size; ++i)
+		{
+			h ^= static_cast<unsigned char>(data[i]);
+			h *= 1099511628211ull;
+		}
+	}
+
+	// Paths are case insensitive and can use either slash
+	uint64_t pathHash(const std::string& path)
+	{
+		std::string normalised = path;
+
+		std::transform(normalised.begin(), normalised.end(), normalised.begin(), [](char c)
+		{
+			return c == '\\' ? '/' : static_cast<char>(std::tolower(c));
+		});
+
+		uint64_t h = 14695981039346656037ull;
+
+		hash(h, normalised.data(), normalised.size());
+
+		return h;
+	}
+
+	std::string cacheFilename(const MeshBinary::Key& key, const std::string& extension = "onyxmesh")
+	{
+		uint64_t h = pathHash(key.source);
+
+		hash(h, reinterpret_cast<const char*>(&key.importOptions), sizeof(key.importOptions));
+
+		std::ostringstream filename;
+		filename << cacheDirectory << std::hex << std::setw(16) << std::setfill('0') << h << "." << extension;
+
+		return filename.str();
+	}
+
+	bool readHeader(std::istream& file, const MeshBinary::Key& key, FileHeader& header)
+	{
+		if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)))
+		{
+			return false;
+		}
+
+		return std::memcmp(header.magic, fileMagic, sizeof(fileMagic)) == 0 &&
+			header.version == fileVersion &&
+			header.pathHash == pathHash(key.source) &&
+			header.importOptions == key.importOptions &&
+			header.sourceSize == key.sourceSize &&
+			header.sourceTime == key.sourceTime;
+	}
+
+	// Whether count elements of the given size starting at offset fit in the file
+	bool fits(uint64_t fileSize, uint64_t offset, uint64_t count, std::size_t size)
+	{
+		return offset <= fileSize && count <= (fileSize - offset) / size;
+	}
+
+	// Read straight into the arrays the mesh will upload. The counts are checked
+	// against the file first, so a corrupt header is a miss rather than a huge
+	// allocation
+	bool readArrays(std::istream& file, const FileHeader& header, std::vector<Vertex>& vertices, std::vector<GLuint>& indices)
+	{
+		file.seekg(0, std::ios::end);
+
+		const uint64_t fileSize = static_cast<uint64_t>(file.tellg());
+
+		if (!file || !fits(fileSize, header.vertexOffset, header.vertexCount, sizeof(Vertex)) ||
+			!fits(fileSize, header.indexOffset, header.indexCount, sizeof(GLuint)) ||
+			header.clusterOffset > fileSize)
+		{
+			return false;
+		}
+
+		vertices.resize(static_cast<std::size_t>(header.vertexCount));
+		indices.resize(static_cast<std::size_t>(header.indexCount));
+
+		file.seekg(header.vertexOffset);
+		file.read(reinterpret_cast<char*>(vertices.data()), vertices.size() * sizeof(Vertex));
+
+		file.seekg(header.indexOffset);
+		file.read(reinterpret_cast<char*>(indices.data()), indices.size() * sizeof(GLuint));
+
+		return !file.fail();
+	}
+
+	void pad(std::ofstream& file, uint64_t offset)
+	{
+		static const char zeros[sectionAlignment] = {};
+
+		const uint64_t position = static_cast<uint64_t>(file.tellp());
+
+		file.write(zeros, offset - position);
+	}
+}
+
+bool MeshBinary::makeKey(const std::string& source, uint64_t importOptions, Key& key)
+{
+	struct _stat64 status;
+
+	if (_stat64(source.c_str(), &status) != 0)
+	{
+		return false;
+	}
+
+	key.source = source;
+	key.sourceSize = static_cast<uint64_t>(status.st_size);
+	key.sourceTime = static_cast<int64_t>(status.st_mtime);
+	key.importOptions = importOptions;
+
+	return true;
+}
+
+void MeshBinary::setCacheDirectory(const std::string& directory)
+{
+	cacheDirectory = directory;
+
+	if (!cacheDirectory.empty() && cacheDirectory.back() != '/' && cacheDirectory.back() != '\\')
+	{
+		cacheDirectory += '/';
+	}
+}
+
+const std::string& MeshBinary::getCacheDirectory()
+{
+	return cacheDirectory;
+}
+
+std::string MeshBinary::getCacheFilename(const Key& key, const std::string& extension)
+{
+	return cacheFilename(key, extension);
+}
+
+bool MeshBinary::isEnabled()
+{
+	return !cacheDirectory.empty();
+}
+
+bool MeshBinary::probe(const Key& key, Info& info)
+{
+	if (!isEnabled())
+	{
+		return false;
+	}
+
+	std::ifstream file(cacheFilename(key).c_str(), std::ios::binary | std::ios::ate);
+
+	if (!file)
+	{
+		return false;
+	}
+
+	info.fileSize = static_cast<uint64_t>(file.tellg());
+
+	file.seekg(0);
+
+	FileHeader header;
+
+	if (!readHeader(file, key, header))
+	{
+		return false;
+	}
+
+	info.contentHash = header.contentHash;
+	info.vertexCount = header.vertexCount;
+	info.indexCount = header.indexCount;
+	info.bounds = AABBf(Vector3f(header.boundsMin[0], header.boundsMin[1], header.boundsMin[2]),
+		Vector3f(header.boundsMax[0], header.boundsMax[1], header.boundsMax[2]));
+
+	return true;
+}
+
+Mesh::Ptr MeshBinary::load(const Key& key)
+{
+	PROFILE_FUNCTION();
+
+	if (!isEnabled())
+	{
+		return nullptr;
+	}
+
+	std::ifstream file(cacheFilename(key).c_str(), std::ios::binary);
+
+	FileHeader header;
+
+	if (!file || !readHeader(file, key, header))
+	{
+		return nullptr;
+	}
+
+	std::vector<Vertex> vertices;
+	std::vector<GLuint> indices;
+
+	if (!readArrays(file, header, vertices, indices))
+	{
+		return nullptr;
+	}
+
+	Mesh::Ptr mesh = Mesh::create();
+
+	mesh->addVertices(std::move(vertices));
+	mesh->addIndices(std::move(indices));
+
+	if (header.clusterOffset != 0)
+	{
+		std::unique_ptr<MeshClusters> clusters(new MeshClusters());
+
+		file.seekg(header.clusterOffset);
+
+		if (!clusters->read(file))
+		{
+			return nullptr;
+		}
+
+		mesh->setClusters(std::move(clusters));
+	}
+
+	return mesh;
+}
+
+bool MeshBinary::load(const Key& key, std::vector<Vertex>& vertices, std::vector<GLuint>& indices)
+{
+	PROFILE_FUNCTION();
+
+	if (!isEnabled())
+	{
+		return false;
+	}
+
+	std::ifstream file(cacheFilename(key).c_str(), std::ios::binary);
+
+	FileHeader header;
+
+	return file && readHeader(file, key, header) && readArrays(file, header, vertices, indices);
+}
+
+bool MeshBinary::save(const Key& key, uint64_t contentHash, const Mesh& mesh)
+{
+	PROFILE_FUNCTION();
+
+	if (!isEnabled())
+	{
+		return false;
+	}
+
+	// The arrays are written straight from the mesh
+	const Mesh::ResidencyPin pin(mesh);
+
+	const AABBf bounds = mesh.getLocalBounds();
+
+	// Only the full detail level until meshes are simplified on import
+	LodLevel lod = {};
+	lod.indexCount = static_cast<uint32_t>(mesh.getIndexCount());
+
+	FileHeader header = {};
+
+	std::memcpy(header.magic, fileMagic, sizeof(fileMagic));
+	header.version = fileVersion;
+	header.lodCount = 1;
+	header.pathHash = pathHash(key.source);
+	header.importOptions = key.importOptions;
+	header.sourceSize = key.sourceSize;
+	header.sourceTime = key.sourceTime;
+	header.contentHash = contentHash;
+	header.vertexCount = mesh.getSize();
+	header.indexCount = mesh.getIndexCount();
+	header.vertexOffset = align(sizeof(FileHeader));
+	header.indexOffset = align(header.vertexOffset + header.vertexCount * sizeof(Vertex));
+	header.lodOffset = align(header.indexOffset + header.indexCount * sizeof(GLuint));
+	header.clusterOffset = mesh.getClusters() ? align(header.lodOffset + header.lodCount * sizeof(LodLevel)) : 0;
+
+	header.boundsMin[0] = bounds.min.x;
+	header.boundsMin[1] = bounds.min.y;
+	header.boundsMin[2] = bounds.min.z;
+	header.boundsMax[0] = bounds.max.x;
+	header.boundsMax[1] = bounds.max.y;
+	header.boundsMax[2] = bounds.max.z;
+
+	_mkdir(cacheDirectory.c_str());
+
+	const std::string filename = cacheFilename(key);
+
+	// Written under a temporary name and renamed once complete, so another
+	// process never sees half a file
+	std::ostringstream temporary;
+	temporary << filename << "." << std::this_thread::get_id() << ".tmp";
+
+	{
+		std::ofstream file(temporary.str().c_str(), std::ios::binary | std::ios::trunc);
+
+		if (!file)
+		{
+			std::cout << "Failed to write mesh cache file: " << filename << std::endl;
+			return false;
+		}
+
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+		pad(file, header.vertexOffset);
+		file.write(reinterpret_cast<const char*>(mesh.getData()), header.vertexCount * sizeof(Vertex));
+
+		pad(file, header.indexOffset);
+		file.write(reinterpret_cast<const char*>(mesh.getIndexData()), header.indexCount * sizeof(GLuint));
+
+		pad(file, header.lodOffset);
+		file.write(reinterpret_cast<const char*>(&lod), sizeof(lod));
+
+		if (header.clusterOffset != 0)
+		{
+			pad(file, header.clusterOffset);
+			mesh.getClusters()->write(file);
+		}
+
+		if (!file)
+		{
+			std::cout << "Failed to write mesh cache file: " << filename << std::endl;
+
+			file.close();
+			std::remove(temporary.str().c_str());
+			return false;
+		}
+	}
+
+	std::remove(filename.c_str());
+
+	if (std::rename(temporary.str().c_str(), filename.c_str()) != 0)
+	{
+		std::remove(temporary.str().c_str());
+		return false;
+	}
+
+	return true;
+}
\ No newline at end of file
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "Mesh.hpp"
+
+#include "math\AABB.hpp"
+
+#include <cstdint>
+#include <string>
+
+// On-disk cache of imported meshes (.onyxmesh) so a file is only parsed the
+// first time it's loaded. A cache file holds the final vertex and index arrays
+// exactly as they're uploaded, each section aligned so the file can be mapped
+// and handed straight to glBufferData, along with the bounds, the LOD chain and
+// the culling clusters.
+//
+// Files are named after the source path and import options, and only used if
+// the source's size and modification time still match, so editing a model or
+// changing how models are imported replaces the cached copy on the next load
+namespace MeshBinary
+{
+	// Everything that decides whether a cached mesh is still valid
+	struct Key
+	{
+		std::string source;
+		uint64_t sourceSize = 0;
+		int64_t sourceTime = 0;				///< Modification time
+		uint64_t importOptions = 0;
+	};
+
+	struct Info
+	{
+		uint64_t contentHash = 0;			///< Of the source file, for spotting copies
+		uint64_t fileSize = 0;				///< Of the cache file
+		uint64_t vertexCount = 0;
+		uint64_t indexCount = 0;
+		AABBf bounds;
+	};
+
+	// False if the source file doesn't exist
+	bool makeKey(const std::string& source, uint64_t importOptions, Key& key);
+
+	// An empty string disables the cache
+	void setCacheDirectory(const std::string& directory);
+
+	bool isEnabled();
+
+	const std::string& getCacheDirectory();
+
+	// Where the cache keeps data for the key, other kinds of derived data use
+	// their own extension
+	std::string getCacheFilename(const Key& key, const std::string& extension = "onyxmesh");
+
+	// Reads only the header, false if there's no valid cache file for the key
+	bool probe(const Key& key, Info& info);
+
+	// Null if there's no valid cache file for the key
+	Mesh::Ptr load(const Key& key);
+
+	// Just the vertex and index arrays, for paging a mesh back in
+	bool load(const Key& key, std::vector<Vertex>& vertices, std::vector<GLuint>& indices);
+
+	bool save(const Key& key, uint64_t contentHash, const Mesh& mesh);
+}
\ No newline at end of file
@@ -0,0 +1,194 @@
+#include "MeshCache.hpp"
+
+#include "profiling\Profiler.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+namespace
+{
+	const std::size_t defaultCpuBudget = std::size_t(1024) * 1024 * 1024;
+	const std::size_t defaultGpuBudget = std::size_t(1024) * 1024 * 1024;
+}
+
+void MeshCache::Statistics::print() const
+{
+	const double megabyte = 1024.0 * 1024.0;
+
+	std::cout << "\nMesh cache: " << meshes << " meshes, " << hits << " hits, " << misses << " misses, "
+		<< evictions << " evictions, " << cpuBytes / megabyte << "MB CPU, " << gpuBytes / megabyte << "MB GPU" << std::endl;
+}
+
+MeshCache& MeshCache::instance()
+{
+	static MeshCache cache;
+
+	return cache;
+}
+
+MeshCache::MeshCache()
+	:
+	m_clock(0),
+	m_cpuBudget(defaultCpuBudget),
+	m_gpuBudget(defaultGpuBudget)
+{
+}
+
+Mesh::Ptr MeshCache::find(const std::string& filename)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	auto it = m_entries.find(filename);
+
+	if (it == m_entries.end())
+	{
+		m_statistics.misses++;
+		return nullptr;
+	}
+
+	m_statistics.hits++;
+
+	it->second.lastUsed = ++m_clock;
+
+	return it->second.mesh;
+}
+
+void MeshCache::insert(const std::string& filename, const Mesh::Ptr& mesh)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	Entry& entry = m_entries[filename];
+
+	entry.mesh = mesh;
+	entry.lastUsed = ++m_clock;
+}
+
+Mesh::Ptr MeshCache::revive(const std::string& filename, const std::weak_ptr<Mesh>& mesh)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	Mesh::Ptr revived = mesh.lock();
+
+	if (revived)
+	{
+		Entry& entry = m_entries[filename];
+
+		entry.mesh = revived;
+		entry.lastUsed = ++m_clock;
+	}
+
+	return revived;
+}
+
+void MeshCache::setCpuBudget(std::size_t bytes)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	m_cpuBudget = bytes;
+}
+
+void MeshCache::setGpuBudget(std::size_t bytes)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	m_gpuBudget = bytes;
+}
+
+void MeshCache::trim()
+{
+	PROFILE_FUNCTION();
+
+	// Declared before the lock so the meshes are destroyed after it's released
+	std::vector<Mesh::Ptr> evicted;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	struct Usage
+	{
+		const Mesh::Ptr* mesh;
+		long references;		///< Entries sharing the mesh
+		uint64_t lastUsed;
+	};
+
+	std::map<const Mesh*, Usage> usage;
+
+	for (auto& entry : m_entries)
+	{
+		auto it = usage.find(entry.second.mesh.get());
+
+		if (it == usage.end())
+		{
+			usage[entry.second.mesh.get()] = { &entry.second.mesh, 1, entry.second.lastUsed };
+		}
+		else
+		{
+			it->second.references++;
+			it->second.lastUsed = std::max(it->second.lastUsed, entry.second.lastUsed);
+		}
+	}
+
+	std::size_t cpuBytes = 0;
+	std::size_t gpuBytes = 0;
+
+	std::vector<Usage> unused;
+
+	for (auto& mesh : usage)
+	{
+		cpuBytes += mesh.first->getCpuBytes();
+		gpuBytes += mesh.first->getGpuBytes();
+
+		// Only the cache refers to it. New references to a mesh nobody else
+		// holds only come from find() and revive(), which both take the lock,
+		// so this can't change under us
+		if (mesh.second.mesh->use_count() == mesh.second.references)
+		{
+			unused.push_back(mesh.second);
+		}
+	}
+
+	if (cpuBytes > m_cpuBudget || gpuBytes > m_gpuBudget)
+	{
+		std::sort(unused.begin(), unused.end(), [](const Usage& a, const Usage& b) { return a.lastUsed < b.lastUsed; });
+
+		for (auto& mesh : unused)
+		{
+			if (cpuBytes <= m_cpuBudget && gpuBytes <= m_gpuBudget)
+			{
+				break;
+			}
+
+			const Mesh* target = mesh.mesh->get();
+
+			cpuBytes -= target->getCpuBytes();
+			gpuBytes -= target->getGpuBytes();
+
+			evicted.push_back(*mesh.mesh);
+
+			for (auto it = m_entries.begin(); it != m_entries.end();)
+			{
+				if (it->second.mesh.get() == target)
+				{
+					it = m_entries.erase(it);
+				}
+				else
+				{
+					++it;
+				}
+			}
+
+			m_statistics.evictions++;
+		}
+	}
+
+	m_statistics.meshes = usage.size() - evicted.size();
+	m_statistics.cpuBytes = cpuBytes;
+	m_statistics.gpuBytes = gpuBytes;
+}
+
+MeshCache::Statistics MeshCache::getStatistics() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	return m_statistics;
+}
\ No newline at end of file
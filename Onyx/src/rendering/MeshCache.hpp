@@ -0,0 +1,81 @@
+#pragma once
+
+#include "Mesh.hpp"
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+// Imported meshes by path. A mesh stays cached while any Model uses it, once
+// nothing else refers to it it's kept only as long as the cache is within its
+// CPU and GPU budgets, least recently used first to go. An evicted mesh is
+// imported again the next time it's asked for, which is cheap as it comes
+// straight back from the mesh cache on disk, see MeshBinary
+class MeshCache
+{
+public:
+
+	struct Statistics
+	{
+		uint64_t hits = 0;
+		uint64_t misses = 0;
+		uint64_t evictions = 0;
+		std::size_t meshes = 0;
+		std::size_t cpuBytes = 0;			///< As of the last trim()
+		std::size_t gpuBytes = 0;
+
+		void print() const;
+	};
+
+	static MeshCache& instance();
+
+	MeshCache(const MeshCache& other) = delete;
+
+	MeshCache& operator=(const MeshCache& other) = delete;
+
+	// Null on a miss. Safe to call from any thread
+	Mesh::Ptr find(const std::string& filename);
+
+	// Safe to call from any thread
+	void insert(const std::string& filename, const Mesh::Ptr& mesh);
+
+	// Takes a reference to a mesh only held weakly elsewhere and caches it
+	// under the filename, or null if it's gone. Done under the cache's lock so
+	// trim() can't decide the mesh is unused at the same time. Safe to call
+	// from any thread
+	Mesh::Ptr revive(const std::string& filename, const std::weak_ptr<Mesh>& mesh);
+
+	void setCpuBudget(std::size_t bytes);
+
+	void setGpuBudget(std::size_t bytes);
+
+	// Render thread: evicts unused meshes until the cache is within budget. The
+	// last reference to an uploaded mesh may be dropped here, so this has to be
+	// where the GL context is
+	void trim();
+
+	Statistics getStatistics() const;
+
+private:
+
+	MeshCache();
+
+	struct Entry
+	{
+		Mesh::Ptr mesh;
+		uint64_t lastUsed;
+	};
+
+	std::map<std::string, Entry> m_entries;		///< Files with the same contents share a mesh
+
+	uint64_t m_clock;							///< Counts up on every access, for ordering entries by use
+
+	std::size_t m_cpuBudget;
+	std::size_t m_gpuBudget;
+
+	Statistics m_statistics;
+
+	mutable std::mutex m_mutex;
+};
\ No newline at end of file
@@ -0,0 +1,329 @@
+#include "MeshClusters.hpp"
+
+#include "profiling\Profiler.hpp"
+
+#include "math\Frustum.hpp"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <xmmintrin.h>
+
+namespace
+{
+	// Spread the low 10 bits of v so there are two zero bits between each
+	uint32_t expandBits(uint32_t v)
+	{
+		v = (v * 0x00010001u) & 0xFF0000FFu;
+		v = (v * 0x00000101u) & 0x0F00F00Fu;
+		v = (v * 0x00000011u) & 0xC30C30C3u;
+		v = (v * 0x00000005u) & 0x49249249u;
+
+		return v;
+	}
+
+	// Position along a Z-order curve, triangles close on the curve are close in space
+	uint32_t mortonCode(const Vector3f& p, const Vector3f& min, const Vector3f& scale)
+	{
+		uint32_t x = static_cast<uint32_t>(std::min(std::max((p.x - min.x) * scale.x, 0.0f), 1023.0f));
+		uint32_t y = static_cast<uint32_t>(std::min(std::max((p.y - min.y) * scale.y, 0.0f), 1023.0f));
+		uint32_t z = static_cast<uint32_t>(std::min(std::max((p.z - min.z) * scale.z, 0.0f), 1023.0f));
+
+		return (expandBits(x) << 2) | (expandBits(y) << 1) | expandBits(z);
+	}
+
+	template <class T>
+	void writeArray(std::ostream& stream, const std::vector<T>& array)
+	{
+		const uint64_t size = array.size();
+
+		stream.write(reinterpret_cast<const char*>(&size), sizeof(size));
+		stream.write(reinterpret_cast<const char*>(array.data()), size * sizeof(T));
+	}
+
+	template <class T>
+	bool readArray(std::istream& stream, std::vector<T>& array)
+	{
+		uint64_t size = 0;
+
+		if (!stream.read(reinterpret_cast<char*>(&size), sizeof(size)))
+		{
+			return false;
+		}
+
+		// A corrupt count shouldn't turn into a huge allocation, there has to be
+		// that much left to read
+		const std::streampos start = stream.tellg();
+
+		stream.seekg(0, std::ios::end);
+
+		const uint64_t remaining = static_cast<uint64_t>(stream.tellg() - start);
+
+		stream.seekg(start);
+
+		if (!stream || size > remaining / sizeof(T))
+		{
+			return false;
+		}
+
+		array.resize(static_cast<std::size_t>(size));
+
+		return size == 0 || stream.read(reinterpret_cast<char*>(array.data()), size * sizeof(T));
+	}
+}
+
+void MeshClusters::build(const std::vector<Vertex>& vertices, std::vector<GLuint>& indices, std::size_t trianglesPerCluster)
+{
+	PROFILE_FUNCTION();
+
+	m_clusters.clear();
+
+	const std::size_t triangleCount = indices.size() / 3;
+
+	if (triangleCount == 0 || trianglesPerCluster == 0)
+	{
+		return;
+	}
+
+	// Sort the triangles along a Z-order curve through their centroids
+	std::vector<Vector3f> centroids(triangleCount);
+
+	Vector3f min(FLT_MAX, FLT_MAX, FLT_MAX);
+	Vector3f max(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+
+	for (std::size_t t = 0; t < triangleCount; ++t)
+	{
+		const Vector3f& a = vertices[indices[t * 3 + 0]].position;
+		const Vector3f& b = vertices[indices[t * 3 + 1]].position;
+		const Vector3f& c = vertices[indices[t * 3 + 2]].position;
+
+		centroids[t] = (a + b + c) / 3.0f;
+
+		min = Vector3f(std::min(min.x, centroids[t].x), std::min(min.y, centroids[t].y), std::min(min.z, centroids[t].z));
+		max = Vector3f(std::max(max.x, centroids[t].x), std::max(max.y, centroids[t].y), std::max(max.z, centroids[t].z));
+	}
+
+	const Vector3f extent = max - min;
+	const Vector3f scale(extent.x > 0.0f ? 1023.0f / extent.x : 0.0f,
+						 extent.y > 0.0f ? 1023.0f / extent.y : 0.0f,
+						 extent.z > 0.0f ? 1023.0f / extent.z : 0.0f);
+
+	std::vector<std::pair<uint32_t, uint32_t>> order(triangleCount);
+
+	for (std::size_t t = 0; t < triangleCount; ++t)
+	{
+		order[t] = std::make_pair(mortonCode(centroids[t], min, scale), static_cast<uint32_t>(t));
+	}
+
+	std::sort(order.begin(), order.end());
+
+	std::vector<GLuint> sorted(indices.size());
+
+	for (std::size_t t = 0; t < triangleCount; ++t)
+	{
+		const std::size_t source = order[t].second;
+
+		sorted[t * 3 + 0] = indices[source * 3 + 0];
+		sorted[t * 3 + 1] = indices[source * 3 + 1];
+		sorted[t * 3 + 2] = indices[source * 3 + 2];
+	}
+
+	// Any trailing indices that don't make a whole triangle stay at the end
+	std::copy(indices.begin() + triangleCount * 3, indices.end(), sorted.begin() + triangleCount * 3);
+
+	indices.swap(sorted);
+
+	// Cut the curve into clusters and bound each one
+	const std::size_t clusterCount = (triangleCount + trianglesPerCluster - 1) / trianglesPerCluster;
+	const std::size_t padded = (clusterCount + 3) & ~std::size_t(3);
+
+	m_clusters.resize(clusterCount);
+
+	m_centerX.assign(padded, 0.0f);
+	m_centerY.assign(padded, 0.0f);
+	m_centerZ.assign(padded, 0.0f);
+	m_radius.assign(padded, -FLT_MAX);
+	m_axisX.assign(padded, 0.0f);
+	m_axisY.assign(padded, 0.0f);
+	m_axisZ.assign(padded, 0.0f);
+	m_coneCos.assign(padded, 0.0f);
+	m_coneSin.assign(padded, 1.0f);
+
+	for (std::size_t i = 0; i < clusterCount; ++i)
+	{
+		const std::size_t first = i * trianglesPerCluster;
+		const std::size_t last = std::min(first + trianglesPerCluster, triangleCount);
+
+		Cluster& cluster = m_clusters[i];
+		cluster.firstIndex = static_cast<GLuint>(first * 3);
+		cluster.indexCount = static_cast<GLsizei>((last - first) * 3);
+
+		// Sphere around the centre of the cluster's bounding box
+		Vector3f boundsMin(FLT_MAX, FLT_MAX, FLT_MAX);
+		Vector3f boundsMax(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+
+		for (std::size_t k = first * 3; k < last * 3; ++k)
+		{
+			const Vector3f& p = vertices[indices[k]].position;
+
+			boundsMin = Vector3f(std::min(boundsMin.x, p.x), std::min(boundsMin.y, p.y), std::min(boundsMin.z, p.z));
+			boundsMax = Vector3f(std::max(boundsMax.x, p.x), std::max(boundsMax.y, p.y), std::max(boundsMax.z, p.z));
+		}
+
+		const Vector3f center = (boundsMin + boundsMax) / 2.0f;
+		float radius = 0.0f;
+
+		for (std::size_t k = first * 3; k < last * 3; ++k)
+		{
+			radius = std::max(radius, (vertices[indices[k]].position - center).Length());
+		}
+
+		// Cone around the face normals, from the winding so it matches what
+		// the rasteriser considers front facing
+		std::vector<Vector3f> normals;
+		normals.reserve(last - first);
+
+		Vector3f axis(0.0f, 0.0f, 0.0f);
+
+		for (std::size_t t = first; t < last; ++t)
+		{
+			const Vector3f& a = vertices[indices[t * 3 + 0]].position;
+			const Vector3f& b = vertices[indices[t * 3 + 1]].position;
+			const Vector3f& c = vertices[indices[t * 3 + 2]].position;
+
+			const Vector3f normal = (b - a).Cross(c - a);
+			const float length = normal.Length();
+
+			if (length > 0.0f)
+			{
+				normals.push_back(normal / length);
+				axis += normals.back();
+			}
+		}
+
+		m_centerX[i] = center.x;
+		m_centerY[i] = center.y;
+		m_centerZ[i] = center.z;
+		m_radius[i] = radius;
+
+		const float axisLength = axis.Length();
+
+		if (axisLength > 0.0f)
+		{
+			axis = axis / axisLength;
+
+			float minDot = 1.0f;
+
+			for (auto& normal : normals)
+			{
+				minDot = std::min(minDot, axis.Dot(normal));
+			}
+
+			// Wider than a hemisphere can always be seen from somewhere, leave
+			// the default cone which never culls
+			if (minDot > 0.0f)
+			{
+				m_axisX[i] = axis.x;
+				m_axisY[i] = axis.y;
+				m_axisZ[i] = axis.z;
+				m_coneCos[i] = minDot;
+				m_coneSin[i] = std::sqrt(1.0f - minDot * minDot);
+			}
+		}
+	}
+}
+
+void MeshClusters::cull(const Matrix4f& modelViewProjection, const Vector3f& cameraPosition, bool backfaceCulling, std::vector<uint32_t>& visible) const
+{
+	PROFILE_FUNCTION();
+
+	const Frustumf frustum(modelViewProjection);
+
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 cameraX = _mm_set1_ps(cameraPosition.x);
+	const __m128 cameraY = _mm_set1_ps(cameraPosition.y);
+	const __m128 cameraZ = _mm_set1_ps(cameraPosition.z);
+
+	for (std::size_t i = 0; i < m_radius.size(); i += 4)
+	{
+		const __m128 x = _mm_loadu_ps(&m_centerX[i]);
+		const __m128 y = _mm_loadu_ps(&m_centerY[i]);
+		const __m128 z = _mm_loadu_ps(&m_centerZ[i]);
+		const __m128 radius = _mm_loadu_ps(&m_radius[i]);
+		const __m128 negativeRadius = _mm_sub_ps(zero, radius);
+
+		// Inside or touching every plane
+		__m128 inside = _mm_cmpeq_ps(zero, zero);
+
+		for (const auto& plane : frustum.planes)
+		{
+			__m128 distance = _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(plane.a)), _mm_mul_ps(y, _mm_set1_ps(plane.b)));
+			distance = _mm_add_ps(distance, _mm_mul_ps(z, _mm_set1_ps(plane.c)));
+			distance = _mm_add_ps(distance, _mm_set1_ps(plane.d));
+
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negativeRadius));
+		}
+
+		if (backfaceCulling)
+		{
+			// Every point of the sphere sees every normal in the cone from behind
+			// when |v| cos(angle(v, axis) + cone angle) > radius, v = center - camera
+			const __m128 vx = _mm_sub_ps(x, cameraX);
+			const __m128 vy = _mm_sub_ps(y, cameraY);
+			const __m128 vz = _mm_sub_ps(z, cameraZ);
+
+			__m128 along = _mm_mul_ps(vx, _mm_loadu_ps(&m_axisX[i]));
+			along = _mm_add_ps(along, _mm_mul_ps(vy, _mm_loadu_ps(&m_axisY[i])));
+			along = _mm_add_ps(along, _mm_mul_ps(vz, _mm_loadu_ps(&m_axisZ[i])));
+
+			__m128 lengthSq = _mm_mul_ps(vx, vx);
+			lengthSq = _mm_add_ps(lengthSq, _mm_mul_ps(vy, vy));
+			lengthSq = _mm_add_ps(lengthSq, _mm_mul_ps(vz, vz));
+
+			const __m128 across = _mm_sqrt_ps(_mm_max_ps(_mm_sub_ps(lengthSq, _mm_mul_ps(along, along)), zero));
+
+			const __m128 facing = _mm_sub_ps(_mm_mul_ps(along, _mm_loadu_ps(&m_coneCos[i])), _mm_mul_ps(across, _mm_loadu_ps(&m_coneSin[i])));
+
+			inside = _mm_andnot_ps(_mm_cmpgt_ps(facing, radius), inside);
+		}
+
+		int mask = _mm_movemask_ps(inside);
+
+		while (mask)
+		{
+			const int lane = (mask & 1) ? 0 : (mask & 2) ? 1 : (mask & 4) ? 2 : 3;
+
+			visible.push_back(static_cast<uint32_t>(i + lane));
+
+			mask &= mask - 1;
+		}
+	}
+}
+
+void MeshClusters::write(std::ostream& stream) const
+{
+	writeArray(stream, m_clusters);
+	writeArray(stream, m_centerX);
+	writeArray(stream, m_centerY);
+	writeArray(stream, m_centerZ);
+	writeArray(stream, m_radius);
+	writeArray(stream, m_axisX);
+	writeArray(stream, m_axisY);
+	writeArray(stream, m_axisZ);
+	writeArray(stream, m_coneCos);
+	writeArray(stream, m_coneSin);
+}
+
+bool MeshClusters::read(std::istream& stream)
+{
+	return readArray(stream, m_clusters) &&
+		readArray(stream, m_centerX) &&
+		readArray(stream, m_centerY) &&
+		readArray(stream, m_centerZ) &&
+		readArray(stream, m_radius) &&
+		readArray(stream, m_axisX) &&
+		readArray(stream, m_axisY) &&
+		readArray(stream, m_axisZ) &&
+		readArray(stream, m_coneCos) &&
+		readArray(stream, m_coneSin);
+}
\ No newline at end of file
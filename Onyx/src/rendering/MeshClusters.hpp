@@ -0,0 +1,67 @@
+#pragma once
+
+#include "GL\glew.h"
+
+#include "math\Vector.hpp"
+#include "math\Matrix.hpp"
+
+#include "Vertex.hpp"
+
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <vector>
+
+// Splits a triangle mesh into small spatially coherent clusters that can be
+// culled on their own. Each cluster has a bounding sphere for frustum culling
+// and a cone bounding its face normals, so a cluster facing entirely away from
+// the camera can be skipped too
+class MeshClusters
+{
+public:
+
+	struct Cluster
+	{
+		GLuint firstIndex;	///< Relative to the start of the mesh's indices
+		GLsizei indexCount;
+	};
+
+	// Reorders the indices so each cluster's triangles are contiguous
+	void build(const std::vector<Vertex>& vertices, std::vector<GLuint>& indices, std::size_t trianglesPerCluster = 128);
+
+	// Appends the index of every cluster that may be visible. The matrix is the
+	// full model-view-projection and the camera position is in model space
+	void cull(const Matrix4f& modelViewProjection, const Vector3f& cameraPosition, bool backfaceCulling, std::vector<uint32_t>& visible) const;
+
+	// Raw copy of the clusters and their culling data for the mesh cache, read()
+	// returns false if the stream ends early
+	void write(std::ostream& stream) const;
+
+	bool read(std::istream& stream);
+
+	std::size_t getClusterCount() const
+	{
+		return m_clusters.size();
+	}
+
+	const Cluster& operator[](std::size_t index) const
+	{
+		return m_clusters[index];
+	}
+
+private:
+
+	std::vector<Cluster> m_clusters;
+
+	// Culling data laid out for SIMD, four clusters at a time. The arrays are
+	// padded to a multiple of four with clusters that always fail
+	std::vector<float> m_centerX;
+	std::vector<float> m_centerY;
+	std::vector<float> m_centerZ;
+	std::vector<float> m_radius;
+	std::vector<float> m_axisX;
+	std::vector<float> m_axisY;
+	std::vector<float> m_axisZ;
+	std::vector<float> m_coneCos;	///< Cosine and sine of the normal cone's half angle
+	std::vector<float> m_coneSin;
+};
\ No newline at end of file
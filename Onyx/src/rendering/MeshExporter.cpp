@@ -0,0 +1,259 @@
+#include "MeshExporter.hpp"
+
+#include "jobs\JobSystem.hpp"
+
+#include "profiling\Profiler.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+namespace
+{
+	// Each job encodes a block this size, and a batch of blocks is encoded
+	// before it's written, which bounds the memory used however big the mesh
+	const std::size_t blockBytes = 1024 * 1024;
+	const std::size_t blocksPerBatch = 32;
+
+	const std::size_t stlHeaderSize = 80;
+	const std::size_t stlTriangleSize = 50;			///< Normal, three corners and a 16 bit attribute
+
+	const std::size_t plyFaceSize = 13;				///< Corner count then three 32 bit indices
+
+	// Both formats are little endian, as is every platform this builds for
+	static_assert(sizeof(Vertex) == 6 * sizeof(float), "PLY vertices are written straight from the mesh");
+
+	std::string getExtension(const std::string& filename)
+	{
+		const std::size_t dot = filename.find_last_of('.');
+
+		if (dot == std::string::npos)
+		{
+			return "";
+		}
+
+		std::string extension = filename.substr(dot + 1);
+
+		std::transform(extension.begin(), extension.end(), extension.begin(), [](char c) { return static_cast<char>(std::tolower(c)); });
+
+		return extension;
+	}
+
+	// The triangles of a mesh whether it's indexed or not, only valid while
+	// the mesh is pinned
+	struct Triangles
+	{
+		const Vertex* vertices;
+		const GLuint* indices;				///< Null if every three vertices make a triangle
+		std::size_t count;
+
+		Triangles(const Mesh& mesh) :
+			vertices(mesh.getData()),
+			indices(mesh.getIndexCount() > 0 ? mesh.getIndexData() : nullptr),
+			count((indices ? mesh.getIndexCount() : mesh.getSize()) / 3)
+		{}
+
+		GLuint index(std::size_t triangle, std::size_t corner) const
+		{
+			const std::size_t i = triangle * 3 + corner;
+
+			return indices ? indices[i] : static_cast<GLuint>(i);
+		}
+	};
+
+	bool isTriangleMesh(const Mesh& mesh, const std::string& filename)
+	{
+		if (mesh.getPrimitiveType() != GL_TRIANGLES)
+		{
+			std::cout << "Can't save " << filename << ", only triangle meshes can be exported" << std::endl;
+			return false;
+		}
+
+		return true;
+	}
+
+	// Encodes count fixed size records with encode(index, destination) and
+	// writes them in order. The records in a batch are encoded in parallel, a
+	// block per job, then the whole batch goes out in one write
+	template <class Encode>
+	bool writeRecords(std::ofstream& file, std::size_t count, std::size_t recordSize, Encode encode)
+	{
+		const std::size_t recordsPerBlock = std::max<std::size_t>(blockBytes / recordSize, 1);
+		const std::size_t recordsPerBatch = recordsPerBlock * blocksPerBatch;
+
+		std::vector<char> buffer(std::min(count, recordsPerBatch) * recordSize);
+
+		for (std::size_t first = 0; first < count; first += recordsPerBatch)
+		{
+			const std::size_t records = std::min(recordsPerBatch, count - first);
+
+			JobSystem::parallelFor(0, records, recordsPerBlock, [&](std::size_t begin, std::size_t end)
+			{
+				for (std::size_t i = begin; i < end; ++i)
+				{
+					encode(first + i, &buffer[i * recordSize]);
+				}
+			});
+
+			if (!file.write(buffer.data(), records * recordSize))
+			{
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	// Unit normal of a triangle, zero for degenerate ones rather than NaN
+	Vector3f faceNormal(const Vector3f& a, const Vector3f& b, const Vector3f& c)
+	{
+		const Vector3f normal = (b - a).Cross(c - a);
+
+		const float length = std::sqrt(normal.x * normal.x + normal.y * normal.y + normal.z * normal.z);
+
+		return length > 0.0f ? normal / length : Vector3f(0.0f, 0.0f, 0.0f);
+	}
+}
+
+bool MeshExporter::save(const Mesh& mesh, const std::string& filename)
+{
+	const std::string extension = getExtension(filename);
+
+	if (extension == "stl")
+	{
+		return saveStl(mesh, filename);
+	}
+
+	if (extension == "ply")
+	{
+		return savePly(mesh, filename);
+	}
+
+	std::cout << "Can't save " << filename << ", only STL and PLY files can be exported" << std::endl;
+
+	return false;
+}
+
+bool MeshExporter::saveStl(const Mesh& mesh, const std::string& filename)
+{
+	PROFILE_FUNCTION();
+
+	if (!isTriangleMesh(mesh, filename))
+	{
+		return false;
+	}
+
+	const Mesh::ResidencyPin pin(mesh);
+	const Triangles triangles(mesh);
+
+	std::ofstream file(filename.c_str(), std::ios::binary | std::ios::trunc);
+
+	if (!file)
+	{
+		std::cout << "Failed to open " << filename << " for writing" << std::endl;
+		return false;
+	}
+
+	char header[stlHeaderSize] = {};
+	std::strncpy(header, "Binary STL exported by Onyx", stlHeaderSize);
+
+	const uint32_t count = static_cast<uint32_t>(triangles.count);
+
+	file.write(header, stlHeaderSize);
+	file.write(reinterpret_cast<const char*>(&count), sizeof(count));
+
+	const bool written = writeRecords(file, triangles.count, stlTriangleSize, [&triangles](std::size_t triangle, char* destination)
+	{
+		const Vector3f& a = triangles.vertices[triangles.index(triangle, 0)].position;
+		const Vector3f& b = triangles.vertices[triangles.index(triangle, 1)].position;
+		const Vector3f& c = triangles.vertices[triangles.index(triangle, 2)].position;
+
+		const Vector3f normal = faceNormal(a, b, c);
+
+		const float record[12] =
+		{
+			normal.x, normal.y, normal.z,
+			a.x, a.y, a.z,
+			b.x, b.y, b.z,
+			c.x, c.y, c.z
+		};
+
+		const uint16_t attributes = 0;
+
+		std::memcpy(destination, record, sizeof(record));
+		std::memcpy(destination + sizeof(record), &attributes, sizeof(attributes));
+	});
+
+	if (!written || !file.flush())
+	{
+		std::cout << "Failed to write " << filename << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+bool MeshExporter::savePly(const Mesh& mesh, const std::string& filename)
+{
+	PROFILE_FUNCTION();
+
+	if (!isTriangleMesh(mesh, filename))
+	{
+		return false;
+	}
+
+	const Mesh::ResidencyPin pin(mesh);
+	const Triangles triangles(mesh);
+
+	std::ofstream file(filename.c_str(), std::ios::binary | std::ios::trunc);
+
+	if (!file)
+	{
+		std::cout << "Failed to open " << filename << " for writing" << std::endl;
+		return false;
+	}
+
+	file << "ply\n"
+		<< "format binary_little_endian 1.0\n"
+		<< "comment Exported by Onyx\n"
+		<< "element vertex " << mesh.getSize() << "\n"
+		<< "property float x\n"
+		<< "property float y\n"
+		<< "property float z\n"
+		<< "property float nx\n"
+		<< "property float ny\n"
+		<< "property float nz\n"
+		<< "element face " << triangles.count << "\n"
+		<< "property list uchar uint vertex_indices\n"
+		<< "end_header\n";
+
+	// Vertices are laid out just as PLY wants them, so they go out in one write
+	file.write(reinterpret_cast<const char*>(triangles.vertices), mesh.getSize() * sizeof(Vertex));
+
+	const bool written = file && writeRecords(file, triangles.count, plyFaceSize, [&triangles](std::size_t triangle, char* destination)
+	{
+		const uint32_t corners[3] =
+		{
+			triangles.index(triangle, 0),
+			triangles.index(triangle, 1),
+			triangles.index(triangle, 2)
+		};
+
+		destination[0] = 3;
+
+		std::memcpy(destination + 1, corners, sizeof(corners));
+	});
+
+	if (!written || !file.flush())
+	{
+		std::cout << "Failed to write " << filename << std::endl;
+		return false;
+	}
+
+	return true;
+}
\ No newline at end of file
@@ -0,0 +1,23 @@
+#pragma once
+
+#include "Mesh.hpp"
+
+#include <string>
+
+// Writes triangle meshes out as binary STL or PLY, picked by the file's
+// extension. The mesh's arrays are encoded straight into large blocks in
+// parallel on the job system and written in order, so a mesh of millions of
+// triangles is written at close to disk speed. Indexed and unindexed meshes
+// are both handled, the vertices are written in the mesh's own space
+namespace MeshExporter
+{
+	// False if the format isn't supported, the mesh isn't made of triangles or
+	// the file can't be written
+	bool save(const Mesh& mesh, const std::string& filename);
+
+	// Triangles with a face normal each, vertices aren't shared
+	bool saveStl(const Mesh& mesh, const std::string& filename);
+
+	// Vertices with their normals followed by the triangles indexing them
+	bool savePly(const Mesh& mesh, const std::string& filename);
+}
\ No newline at end of file
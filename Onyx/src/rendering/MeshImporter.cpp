@@ -0,0 +1,610 @@
+#include "MeshImporter.hpp"
+#include "MeshBinary.hpp"
+#include "MeshCache.hpp"
+#include "TextMeshParser.hpp"
+
+#include <assimp/Importer.hpp>
+#include <assimp/scene.h>
+#include <assimp/postprocess.h>
+
+#include "jobs\JobSystem.hpp"
+
+#include "profiling\Profiler.hpp"
+
+#include <io.h>
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <utility>
+
+namespace
+{
+	// Triangles are sorted from points and lines so those can be skipped
+	const unsigned int importFlags = aiProcess_Triangulate | aiProcess_SortByPType | aiProcess_GenSmoothNormals;
+	const unsigned int clusterThreshold = 4096;
+
+	// Bumped whenever the text parsers change what they produce. Meshes cached
+	// before there was one, from Assimp, have zero here
+	const unsigned int parserVersion = 2;
+
+	// Changing any of them means meshes in the cache are out of date
+	const uint64_t importOptions = (uint64_t(parserVersion) << 56) | (uint64_t(clusterThreshold) << 32) | importFlags;
+
+	// Files are the same if they hash the same and are the same size
+	typedef std::pair<uint64_t, uint64_t> ContentKey;
+
+	// Weak so it doesn't stop the MeshCache evicting the mesh
+	struct Content
+	{
+		std::weak_ptr<Mesh> mesh;
+		JobSystem::Handle parse;		///< Finished once the mesh is set
+	};
+
+	Mesh::Residency residency = Mesh::Residency::GpuOnly;
+
+	std::mutex contentMutex;
+	std::map<ContentKey, Content> contentMap;
+
+	struct FileLoad
+	{
+		std::string filename;
+		std::vector<char> data;
+		ContentKey key;
+
+		MeshBinary::Key cacheKey;
+		bool hasCacheKey = false;
+		bool cached = false;			///< Load from the mesh cache rather than parsing
+
+		bool owner = false;				///< This load parses the file, the rest wait on it
+		bool failed = false;
+		JobSystem::Handle waitFor;		///< Parse of an identical file to share
+
+		Mesh::Ptr mesh;
+		uint64_t bytes = 0;
+		uint64_t triangles = 0;
+	};
+
+	// 64 bit FNV-1a
+	uint64_t hashContents(const std::vector<char>& data)
+	{
+		uint64_t hash = 14695981039346656037ull;
+
+		for (char c : data)
+		{
+			hash ^= static_cast<unsigned char>(c);
+			hash *= 1099511628211ull;
+		}
+
+		return hash;
+	}
+
+	std::string getExtension(const std::string& filename)
+	{
+		const std::size_t dot = filename.find_last_of('.');
+
+		if (dot == std::string::npos)
+		{
+			return "";
+		}
+
+		std::string extension = filename.substr(dot + 1);
+
+		std::transform(extension.begin(), extension.end(), extension.begin(), [](char c) { return static_cast<char>(std::tolower(c)); });
+
+		return extension;
+	}
+
+	bool readFile(const std::string& filename, std::vector<char>& data)
+	{
+		PROFILE_FUNCTION();
+
+		std::ifstream file(filename.c_str(), std::ios::binary | std::ios::ate);
+
+		if (!file)
+		{
+			return false;
+		}
+
+		data.resize(static_cast<std::size_t>(file.tellg()));
+
+		file.seekg(0);
+
+		return data.empty() || file.read(data.data(), data.size());
+	}
+
+	// A mesh placed in the scene by a node, the same mesh can be placed by more than one
+	struct MeshInstance
+	{
+		const aiMesh* mesh;
+		aiMatrix4x4 transform;			///< From the mesh's space to the scene's
+	};
+
+	void collectInstances(const aiScene* scene, const aiNode* node, const aiMatrix4x4& parentTransform, std::vector<MeshInstance>& instances)
+	{
+		const aiMatrix4x4 transform = parentTransform * node->mTransformation;
+
+		for (unsigned int i = 0; i < node->mNumMeshes; i++)
+		{
+			const aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
+
+			// Points and lines are sorted into meshes of their own, only triangles are drawn
+			if (mesh->mPrimitiveTypes == aiPrimitiveType_TRIANGLE && mesh->HasNormals())
+			{
+				instances.push_back({ mesh, transform });
+			}
+		}
+
+		for (unsigned int i = 0; i < node->mNumChildren; i++)
+		{
+			collectInstances(scene, node->mChildren[i], transform, instances);
+		}
+	}
+
+	bool importScene(const FileLoad& load, const std::string& extension, std::vector<Vertex>& vertices, std::vector<GLuint>& indices)
+	{
+		PROFILE_FUNCTION();
+
+		Assimp::Importer importer;
+
+		const aiScene* scene = nullptr;
+		{
+			PROFILE_SCOPE("Assimp::Importer::ReadFileFromMemory");
+
+			// The extension tells Assimp which format to expect
+			scene = importer.ReadFileFromMemory(load.data.data(), load.data.size(), importFlags, extension.c_str());
+		}
+
+		std::vector<MeshInstance> instances;
+
+		if (scene && scene->mRootNode)
+		{
+			collectInstances(scene, scene->mRootNode, aiMatrix4x4(), instances);
+		}
+
+		if (instances.empty())
+		{
+			std::cout << load.filename << ": " << (scene ? "no triangles" : importer.GetErrorString()) << std::endl;
+			return false;
+		}
+
+		// Every part of the scene is baked into one static mesh, so it's pooled and
+		// drawn in one go however many parts the file has. Parts are grouped by
+		// material so each material is a contiguous run of indices
+		std::stable_sort(instances.begin(), instances.end(), [](const MeshInstance& a, const MeshInstance& b)
+		{
+			return a.mesh->mMaterialIndex < b.mesh->mMaterialIndex;
+		});
+
+		{
+			PROFILE_SCOPE("Copy vertices");
+
+			std::size_t vertexCount = 0;
+			std::size_t faceCount = 0;
+
+			for (const MeshInstance& instance : instances)
+			{
+				vertexCount += instance.mesh->mNumVertices;
+				faceCount += instance.mesh->mNumFaces;
+			}
+
+			vertices.reserve(vertexCount);
+			indices.reserve(faceCount * 3);
+
+			for (const MeshInstance& instance : instances)
+			{
+				const aiMesh* part = instance.mesh;
+
+				// Normals go through the inverse transpose so they stay at right
+				// angles to the surface under non-uniform scales
+				const aiMatrix3x3 normalTransform = aiMatrix3x3(instance.transform).Inverse().Transpose();
+
+				// A mirroring transform turns the faces inside out, so swap their winding back
+				const bool mirrored = instance.transform.Determinant() < 0.0f;
+
+				const GLuint base = static_cast<GLuint>(vertices.size());
+
+				for (unsigned int i = 0; i < part->mNumVertices; i++)
+				{
+					const aiVector3D pos = instance.transform * part->mVertices[i];
+					const aiVector3D norm = (normalTransform * part->mNormals[i]).NormalizeSafe();
+
+					vertices.push_back(Vertex({ Vector3f(pos.x, pos.y, pos.z), Vector3f(norm.x, norm.y, norm.z) }));
+				}
+
+				for (unsigned int i = 0; i < part->mNumFaces; i++)
+				{
+					const aiFace& face = part->mFaces[i];
+
+					assert(face.mNumIndices == 3);
+
+					indices.push_back(base + face.mIndices[0]);
+					indices.push_back(base + face.mIndices[mirrored ? 2 : 1]);
+					indices.push_back(base + face.mIndices[mirrored ? 1 : 2]);
+				}
+			}
+		}
+
+		return true;
+	}
+
+	Mesh::Ptr parse(const FileLoad& load, uint64_t& triangles)
+	{
+		PROFILE_FUNCTION();
+
+		const std::string extension = getExtension(load.filename);
+		const std::string_view text(load.data.data(), load.data.size());
+
+		std::vector<Vertex> vertices;
+		std::vector<GLuint> indices;
+
+		// Text formats are parsed in parallel without Assimp, its readers for
+		// them are slow and single threaded
+		bool parsed = false;
+
+		if (TextMeshParser::canParse(extension, text))
+		{
+			parsed = TextMeshParser::parse(extension, text, vertices, indices);
+
+			if (!parsed)
+			{
+				std::cout << load.filename << ": couldn't be parsed as text, trying Assimp" << std::endl;
+			}
+		}
+
+		if (!parsed && !importScene(load, extension, vertices, indices))
+		{
+			return nullptr;
+		}
+
+		triangles = indices.size() / 3;
+
+		std::cout << "\nFinished loading: " << load.filename << " with " << vertices.size() << " vertices..." << std::endl;
+
+		Mesh::Ptr mesh = Mesh::create();
+
+		mesh->addVertices(std::move(vertices));
+		mesh->addIndices(std::move(indices));
+
+		// Big meshes are split up so parts of them can be culled
+		if (triangles >= clusterThreshold)
+		{
+			mesh->buildClusters();
+		}
+
+		return mesh;
+	}
+
+	// Entries for meshes that are gone and won't be set again, otherwise every
+	// file ever loaded would keep one along with its finished parse job. Loads
+	// of a duplicate hold the parse job until they've looked the mesh up, and
+	// only take it under the lock, so one held nowhere else can't be wanted
+	void pruneContent()
+	{
+		std::lock_guard<std::mutex> lock(contentMutex);
+
+		for (auto it = contentMap.begin(); it != contentMap.end();)
+		{
+			const Content& content = it->second;
+
+			if (JobSystem::isFinished(content.parse) && content.mesh.expired() && content.parse.use_count() == 1)
+			{
+				it = contentMap.erase(it);
+			}
+			else
+			{
+				++it;
+			}
+		}
+	}
+
+	void readStage(FileLoad& load, const JobSystem::Handle& parseJob)
+	{
+		load.mesh = MeshCache::instance().find(load.filename);
+
+		if (load.mesh)
+		{
+			std::cout << "\nLoaded: " << load.filename << " from mesh map" << std::endl;
+			return;
+		}
+
+		load.hasCacheKey = MeshBinary::makeKey(load.filename, importOptions, load.cacheKey);
+
+		MeshBinary::Info info;
+
+		if (load.hasCacheKey && MeshBinary::probe(load.cacheKey, info))
+		{
+			// The header remembers the source's hash so copies are still spotted
+			load.cached = true;
+			load.key = ContentKey(info.contentHash, load.cacheKey.sourceSize);
+			load.bytes = info.fileSize;
+		}
+		else
+		{
+			if (!readFile(load.filename, load.data))
+			{
+				std::cout << "Failed to read " << load.filename << std::endl;
+
+				load.failed = true;
+				return;
+			}
+
+			load.key = ContentKey(hashContents(load.data), load.data.size());
+			load.bytes = load.data.size();
+		}
+
+		std::lock_guard<std::mutex> lock(contentMutex);
+
+		auto it = contentMap.find(load.key);
+
+		// An evicted mesh has to be loaded again
+		if (it != contentMap.end() && (!JobSystem::isFinished(it->second.parse) || !it->second.mesh.expired()))
+		{
+			// Same bytes as a file that's loaded or being loaded, no need to parse
+			load.waitFor = it->second.parse;
+			load.data.clear();
+			load.data.shrink_to_fit();
+		}
+		else
+		{
+			load.owner = true;
+
+			Content& content = contentMap[load.key];
+			content.parse = parseJob;
+		}
+	}
+
+	void parseStage(FileLoad& load)
+	{
+		if (!load.owner)
+		{
+			return;
+		}
+
+		Mesh::Ptr mesh;
+
+		bool onDisk = false;			///< In the mesh cache, so it can be paged back in from there
+
+		if (load.cached)
+		{
+			mesh = MeshBinary::load(load.cacheKey);
+			onDisk = mesh != nullptr;
+
+			if (mesh)
+			{
+				load.triangles = mesh->getIndexCount() / 3;
+
+				std::cout << "\nLoaded: " << load.filename << " from mesh cache" << std::endl;
+			}
+			else
+			{
+				// The cache file changed since it was checked, parse the source instead
+				load.cached = false;
+
+				if (readFile(load.filename, load.data))
+				{
+					load.bytes = load.data.size();
+				}
+			}
+		}
+
+		if (!mesh && !load.data.empty())
+		{
+			mesh = parse(load, load.triangles);
+
+			if (mesh && load.hasCacheKey)
+			{
+				onDisk = MeshBinary::save(load.cacheKey, load.key.first, *mesh);
+			}
+		}
+
+		if (mesh)
+		{
+			// A GPU-only mesh needs the cache file to page back in from
+			mesh->setResidency(residency == Mesh::Residency::GpuOnly && !onDisk ? Mesh::Residency::CpuAndGpu : residency);
+
+			if (onDisk)
+			{
+				const MeshBinary::Key cacheKey = load.cacheKey;
+
+				mesh->setSource([cacheKey](std::vector<Vertex>& vertices, std::vector<GLuint>& indices)
+				{
+					return MeshBinary::load(cacheKey, vertices, indices);
+				});
+			}
+		}
+
+		load.data.clear();
+		load.data.shrink_to_fit();
+
+		if (mesh)
+		{
+			MeshCache::instance().insert(load.filename, mesh);
+		}
+
+		std::lock_guard<std::mutex> lock(contentMutex);
+
+		if (mesh)
+		{
+			contentMap[load.key].mesh = mesh;
+		}
+		else
+		{
+			// Forget the failure so the file can be tried again
+			contentMap.erase(load.key);
+		}
+
+		load.mesh = mesh;
+		load.failed = !mesh;
+	}
+}
+
+void MeshImporter::Statistics::print() const
+{
+	std::cout << "\nImported " << files << " files (" << cacheHits << " from mesh cache, " << duplicates << " duplicates, " << failures << " failed) in "
+		<< seconds * 1000.0 << "ms" << std::endl;
+
+	if (seconds > 0.0)
+	{
+		std::cout << "Throughput: " << bytes / seconds / (1024.0 * 1024.0) << " MB/s, "
+			<< triangles / seconds / 1.0e6 << " Mtris/s" << std::endl;
+	}
+}
+
+void MeshImporter::setResidency(Mesh::Residency meshResidency)
+{
+	residency = meshResidency;
+}
+
+Mesh::Ptr MeshImporter::import(const std::string& filename)
+{
+	return importAll(std::vector<std::string>(1, filename)).front();
+}
+
+std::vector<Mesh::Ptr> MeshImporter::importAll(const std::vector<std::string>& filenames, Statistics* statistics)
+{
+	PROFILE_FUNCTION();
+
+	const auto start = std::chrono::steady_clock::now();
+
+	pruneContent();
+
+	std::vector<FileLoad> loads(filenames.size());
+
+	JobSystem::Handle root = JobSystem::create([]() {});
+
+	for (std::size_t i = 0; i < loads.size(); ++i)
+	{
+		FileLoad& load = loads[i];
+		load.filename = filenames[i];
+
+		JobSystem::Handle parseJob = JobSystem::createChild(root, [&load]() { parseStage(load); });
+		JobSystem::Handle readJob = JobSystem::createChild(root, [&load, parseJob]() { readStage(load, parseJob); });
+
+		JobSystem::addDependency(parseJob, readJob);
+
+		JobSystem::run(parseJob);
+		JobSystem::run(readJob);
+	}
+
+	JobSystem::run(root);
+	JobSystem::wait(root);
+
+	std::vector<Mesh::Ptr> meshes(loads.size());
+
+	Statistics stats;
+
+	for (std::size_t i = 0; i < loads.size(); ++i)
+	{
+		FileLoad& load = loads[i];
+
+		// Duplicates of a file parsed by another thread may still be waiting
+		if (load.waitFor)
+		{
+			JobSystem::wait(load.waitFor);
+
+			// Failed parses are removed, so if it's there it did parse
+			bool parsed = false;
+			std::weak_ptr<Mesh> parsedMesh;
+
+			{
+				std::lock_guard<std::mutex> lock(contentMutex);
+
+				auto it = contentMap.find(load.key);
+
+				if (it != contentMap.end())
+				{
+					parsedMesh = it->second.mesh;
+					parsed = true;
+				}
+			}
+
+			// Through the cache so it can't be evicted as it's picked up
+			if (parsed)
+			{
+				load.mesh = MeshCache::instance().revive(load.filename, parsedMesh);
+			}
+
+			if (!load.mesh && parsed)
+			{
+				// Evicted since it was parsed, which only happens under memory
+				// pressure, so just load it again
+				load.mesh = import(load.filename);
+			}
+
+			load.failed = !load.mesh;
+		}
+
+		meshes[i] = load.mesh;
+
+		stats.files++;
+		stats.cacheHits += load.cached ? 1 : 0;
+		stats.bytes += load.bytes;
+		stats.triangles += load.triangles;
+
+		if (load.failed)
+		{
+			stats.failures++;
+		}
+		else if (!load.owner)
+		{
+			stats.duplicates++;
+		}
+	}
+
+	stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	if (statistics)
+	{
+		*statistics = stats;
+	}
+
+	return meshes;
+}
+
+std::vector<std::string> MeshImporter::listDirectory(const std::string& directory)
+{
+	static const char* extensions[] = { "stl", "obj", "ply", "fbx", "3ds", "dae" };
+
+	std::vector<std::string> files;
+
+	std::string path = directory;
+
+	if (!path.empty() && path.back() != '/' && path.back() != '\\')
+	{
+		path += "/";
+	}
+
+	_finddata_t entry;
+	intptr_t handle = _findfirst((path + "*").c_str(), &entry);
+
+	if (handle == -1)
+	{
+		return files;
+	}
+
+	do
+	{
+		if (entry.attrib & _A_SUBDIR)
+		{
+			continue;
+		}
+
+		const std::string extension = getExtension(entry.name);
+
+		if (std::find(std::begin(extensions), std::end(extensions), extension) != std::end(extensions))
+		{
+			files.push_back(path + entry.name);
+		}
+	} while (_findnext(handle, &entry) == 0);
+
+	_findclose(handle);
+
+	std::sort(files.begin(), files.end());
+
+	return files;
+}
\ No newline at end of file
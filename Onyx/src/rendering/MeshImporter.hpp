@@ -0,0 +1,46 @@
+#pragma once
+
+#include "Mesh.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Turns model files into meshes ready for complete(). Every mesh in a file is
+// placed where its node puts it and merged into one, so a multi-part file is a
+// single mesh drawn in one go. Meshes are kept in the MeshCache by path and
+// looked up by a hash of the file's contents, so loading a path again or a copy
+// of a file already loaded shares the mesh. Parsed meshes are saved to the mesh
+// cache and loaded from there next time, see MeshBinary. Safe to call from any
+// thread
+namespace MeshImporter
+{
+	struct Statistics
+	{
+		std::size_t files = 0;
+		std::size_t duplicates = 0;			///< Already loaded under another path or earlier in the batch
+		std::size_t cacheHits = 0;			///< Loaded from the mesh cache instead of parsed
+		std::size_t failures = 0;
+		uint64_t bytes = 0;					///< Read from disk, the cache file's size for cache hits
+		uint64_t triangles = 0;				///< Parsed, duplicates aren't counted twice
+		double seconds = 0.0;
+
+		void print() const;
+	};
+
+	// How newly imported meshes are kept once uploaded, GPU-only by default with
+	// the mesh cache to page them back in from. Meshes that couldn't be cached
+	// stay in RAM as well. Set it before importing anything
+	void setResidency(Mesh::Residency residency);
+
+	// Null if the file couldn't be read or parsed
+	Mesh::Ptr import(const std::string& filename);
+
+	// Imports every file concurrently on the job system, returning the meshes
+	// in the same order. Each file is read by one job and parsed by another that
+	// follows it, so reading some files overlaps parsing others
+	std::vector<Mesh::Ptr> importAll(const std::vector<std::string>& filenames, Statistics* statistics = nullptr);
+
+	// The files in a directory that can be imported, sorted by name
+	std::vector<std::string> listDirectory(const std::string& directory);
+}
\ No newline at end of file
@@ -0,0 +1,329 @@
+#include "MeshPool.hpp"
+
+#include "profiling\Profiler.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <iostream>
+#include <utility>
+
+namespace
+{
+	const std::size_t initialVertexCapacity = 1 << 18;
+	const std::size_t initialIndexCapacity = 1 << 20;
+}
+
+GLuint MeshPool::s_boundVao = 0;
+
+MeshPool& MeshPool::instance()
+{
+	// Created on first use so a GL context is current by then
+	static MeshPool pool;
+
+	return pool;
+}
+
+MeshPool::MeshPool()
+	:
+	m_vertices(GL_ARRAY_BUFFER, GL_STATIC_DRAW),
+	m_indices(GL_ELEMENT_ARRAY_BUFFER, GL_STATIC_DRAW),
+	m_drawIds(GL_ARRAY_BUFFER, GL_STATIC_DRAW),
+	m_vertexAllocator(initialVertexCapacity),
+	m_indexAllocator(initialIndexCapacity)
+{
+	glGenVertexArrays(1, &m_vao);
+
+	bindVertexArray(0);
+
+	m_vertices.data(initialVertexCapacity * sizeof(Vertex), nullptr);
+	m_indices.data(initialIndexCapacity * sizeof(GLuint), nullptr);
+
+	std::vector<GLuint> drawIds(MaxDrawIds);
+
+	for (std::size_t i = 0; i < drawIds.size(); ++i)
+	{
+		drawIds[i] = static_cast<GLuint>(i);
+	}
+
+	m_drawIds.data(drawIds.size() * sizeof(GLuint), drawIds.data());
+
+	setupAttributes();
+}
+
+MeshPool::~MeshPool()
+{
+	if (m_vao != 0)
+	{
+		glDeleteVertexArrays(1, &m_vao);
+	}
+}
+
+void MeshPool::release()
+{
+	if (m_vao == 0)
+	{
+		return;
+	}
+
+	bindVertexArray(0);
+
+	glDeleteVertexArrays(1, &m_vao);
+	m_vao = 0;
+
+	// Moved out to be destroyed here, leaving the members nothing to delete
+	{
+		VBO vertices(std::move(m_vertices));
+		VBO indices(std::move(m_indices));
+		VBO drawIds(std::move(m_drawIds));
+	}
+}
+
+MeshPool::Handle MeshPool::allocate(const std::vector<Vertex>& vertices, const std::vector<GLuint>& indices)
+{
+	PROFILE_FUNCTION();
+
+	if (!reserve(vertices.size(), indices.size()))
+	{
+		return InvalidHandle;
+	}
+
+	Range range;
+	range.baseVertex = static_cast<GLint>(m_vertexAllocator.allocate(vertices.size()));
+	range.firstIndex = static_cast<GLuint>(m_indexAllocator.allocate(indices.size()));
+	range.vertexCount = static_cast<GLsizei>(vertices.size());
+	range.indexCount = static_cast<GLsizei>(indices.size());
+
+	// Buffer updates would otherwise change the element buffer of whichever
+	// vertex array is bound
+	bindVertexArray(0);
+
+	if (!vertices.empty())
+	{
+		m_vertices.subData(range.baseVertex * sizeof(Vertex), vertices.size() * sizeof(Vertex), vertices.data());
+	}
+	if (!indices.empty())
+	{
+		m_indices.subData(range.firstIndex * sizeof(GLuint), indices.size() * sizeof(GLuint), indices.data());
+	}
+
+	Handle handle;
+
+	if (!m_freeHandles.empty())
+	{
+		handle = m_freeHandles.back();
+		m_freeHandles.pop_back();
+
+		m_ranges[handle] = range;
+		m_live[handle] = true;
+	}
+	else
+	{
+		handle = static_cast<Handle>(m_ranges.size());
+
+		m_ranges.push_back(range);
+		m_live.push_back(true);
+	}
+
+	return handle;
+}
+
+void MeshPool::free(Handle handle)
+{
+	if (handle >= m_ranges.size() || !m_live[handle])
+	{
+		return;
+	}
+
+	const Range& range = m_ranges[handle];
+
+	m_vertexAllocator.free(range.baseVertex, range.vertexCount);
+	m_indexAllocator.free(range.firstIndex, range.indexCount);
+
+	m_live[handle] = false;
+	m_freeHandles.push_back(handle);
+}
+
+void MeshPool::updateVertices(Handle handle, std::size_t first, std::size_t count, const Vertex* vertices)
+{
+	const Range& range = getRange(handle);
+
+	assert(first + count <= static_cast<std::size_t>(range.vertexCount));
+
+	if (count == 0)
+	{
+		return;
+	}
+
+	bindVertexArray(0);
+
+	m_vertices.subData((range.baseVertex + first) * sizeof(Vertex), count * sizeof(Vertex), vertices + first);
+}
+
+const MeshPool::Range& MeshPool::getRange(Handle handle) const
+{
+	assert(handle < m_ranges.size() && m_live[handle]);
+
+	return m_ranges[handle];
+}
+
+void MeshPool::bind()
+{
+	bindVertexArray(m_vao);
+}
+
+void MeshPool::defragment()
+{
+	PROFILE_FUNCTION();
+
+	reallocate(m_vertexAllocator.getCapacity(), m_indexAllocator.getCapacity());
+}
+
+std::size_t MeshPool::getVertexCapacity() const
+{
+	return m_vertexAllocator.getCapacity();
+}
+
+std::size_t MeshPool::getVertexCount() const
+{
+	return m_vertexAllocator.getUsedSize();
+}
+
+std::size_t MeshPool::getIndexCapacity() const
+{
+	return m_indexAllocator.getCapacity();
+}
+
+std::size_t MeshPool::getIndexCount() const
+{
+	return m_indexAllocator.getUsedSize();
+}
+
+void MeshPool::bindVertexArray(GLuint vao)
+{
+	if (vao != s_boundVao)
+	{
+		glBindVertexArray(vao);
+		s_boundVao = vao;
+	}
+}
+
+bool MeshPool::reserve(std::size_t vertices, std::size_t indices)
+{
+	if (m_vertexAllocator.getLargestFreeBlock() >= vertices && m_indexAllocator.getLargestFreeBlock() >= indices)
+	{
+		return true;
+	}
+
+	// Enough space in total, it's just in pieces
+	if (m_vertexAllocator.getFreeSize() >= vertices && m_indexAllocator.getFreeSize() >= indices)
+	{
+		defragment();
+		return true;
+	}
+
+	std::size_t vertexCapacity = m_vertexAllocator.getCapacity();
+	std::size_t indexCapacity = m_indexAllocator.getCapacity();
+
+	while (vertexCapacity - m_vertexAllocator.getUsedSize() < vertices)
+	{
+		vertexCapacity *= 2;
+	}
+	while (indexCapacity - m_indexAllocator.getUsedSize() < indices)
+	{
+		indexCapacity *= 2;
+	}
+
+	std::cout << "\nGrowing mesh pool to " << vertexCapacity << " vertices and " << indexCapacity << " indices" << std::endl;
+
+	reallocate(vertexCapacity, indexCapacity);
+
+	return true;
+}
+
+void MeshPool::reallocate(std::size_t vertexCapacity, std::size_t indexCapacity)
+{
+	PROFILE_FUNCTION();
+
+	bindVertexArray(0);
+
+	VBO vertices(GL_ARRAY_BUFFER, GL_STATIC_DRAW);
+	VBO indices(GL_ELEMENT_ARRAY_BUFFER, GL_STATIC_DRAW);
+
+	vertices.data(vertexCapacity * sizeof(Vertex), nullptr);
+	indices.data(indexCapacity * sizeof(GLuint), nullptr);
+
+	// Copy every live mesh into the new buffers back to back. Copying between
+	// two buffers means the old and new ranges never overlap
+	std::size_t vertexOffset = 0;
+	std::size_t indexOffset = 0;
+
+	for (std::size_t handle = 0; handle < m_ranges.size(); ++handle)
+	{
+		if (!m_live[handle])
+		{
+			continue;
+		}
+
+		Range& range = m_ranges[handle];
+
+		if (range.vertexCount > 0)
+		{
+			glBindBuffer(GL_COPY_READ_BUFFER, m_vertices.name());
+			glBindBuffer(GL_COPY_WRITE_BUFFER, vertices.name());
+			glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+				range.baseVertex * sizeof(Vertex), vertexOffset * sizeof(Vertex), range.vertexCount * sizeof(Vertex));
+		}
+
+		if (range.indexCount > 0)
+		{
+			glBindBuffer(GL_COPY_READ_BUFFER, m_indices.name());
+			glBindBuffer(GL_COPY_WRITE_BUFFER, indices.name());
+			glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+				range.firstIndex * sizeof(GLuint), indexOffset * sizeof(GLuint), range.indexCount * sizeof(GLuint));
+		}
+
+		range.baseVertex = static_cast<GLint>(vertexOffset);
+		range.firstIndex = static_cast<GLuint>(indexOffset);
+
+		vertexOffset += range.vertexCount;
+		indexOffset += range.indexCount;
+	}
+
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+	// The old buffers are released when the temporaries go out of scope
+	m_vertices = std::move(vertices);
+	m_indices = std::move(indices);
+
+	m_vertexAllocator = FreeListAllocator(vertexCapacity);
+	m_vertexAllocator.reset(vertexOffset);
+
+	m_indexAllocator = FreeListAllocator(indexCapacity);
+	m_indexAllocator.reset(indexOffset);
+
+	setupAttributes();
+}
+
+void MeshPool::setupAttributes()
+{
+	bindVertexArray(m_vao);
+
+	m_vertices.bind();
+	m_indices.bind();
+
+	// Vertex Positions
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)offsetof(Vertex, position));
+	// Vertex Normals
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)offsetof(Vertex, normal));
+	// Draw index, advances once per instance starting at the base instance
+	m_drawIds.bind();
+	glEnableVertexAttribArray(2);
+	glVertexAttribIPointer(2, 1, GL_UNSIGNED_INT, sizeof(GLuint), NULL);
+	glVertexAttribDivisor(2, 1);
+
+	bindVertexArray(0);
+}
\ No newline at end of file
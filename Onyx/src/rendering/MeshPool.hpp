@@ -0,0 +1,102 @@
+#pragma once
+
+#include "GL\glew.h"
+
+#include "buffers\VBO.hpp"
+#include "buffers\FreeListAllocator.hpp"
+
+#include "Vertex.hpp"
+
+#include <vector>
+
+// Shared vertex and index buffers for all static meshes. Each mesh gets a
+// range of both and is drawn with its base vertex and first index, so every
+// pooled mesh uses the same vertex array and the whole scene can be drawn
+// from the same buffers
+class MeshPool
+{
+public:
+
+	typedef unsigned int Handle;
+
+	static const Handle InvalidHandle = ~0u;
+
+	// Vertex attribute 2 is a per-instance draw index read from an identity
+	// buffer, so a draw's base instance selects its per-draw data. That is how
+	// multi-draw indirect batches find their transforms without gl_DrawID
+	static const std::size_t MaxDrawIds = 1 << 16;
+
+	struct Range
+	{
+		GLint baseVertex;		///< Added to every index, the offset of the mesh's vertices
+		GLuint firstIndex;
+		GLsizei vertexCount;
+		GLsizei indexCount;
+	};
+
+	static MeshPool& instance();
+
+	~MeshPool();
+
+	// Delete the buffers and vertex array while the context is still current,
+	// the pool lives until static destruction when it's long gone. Nothing can
+	// be drawn from the pool afterwards, meshes can still be freed from it
+	void release();
+
+	MeshPool(const MeshPool& other) = delete;
+
+	MeshPool& operator=(const MeshPool& other) = delete;
+
+	// Indices are relative to the mesh's own vertices
+	Handle allocate(const std::vector<Vertex>& vertices, const std::vector<GLuint>& indices);
+
+	void free(Handle handle);
+
+	void updateVertices(Handle handle, std::size_t first, std::size_t count, const Vertex* vertices);
+
+	// Ranges move when the pool is defragmented, don't hold on to them
+	const Range& getRange(Handle handle) const;
+
+	void bind();
+
+	// Pack every mesh to the front of the buffers so the free space is one block
+	void defragment();
+
+	std::size_t getVertexCapacity() const;
+
+	std::size_t getVertexCount() const;
+
+	std::size_t getIndexCapacity() const;
+
+	std::size_t getIndexCount() const;
+
+	// All vertex array binds go through here so repeated binds of the pool's
+	// vertex array between pooled draws are skipped
+	static void bindVertexArray(GLuint vao);
+
+private:
+
+	MeshPool();
+
+	bool reserve(std::size_t vertices, std::size_t indices);
+
+	// Move every mesh into new buffers of the given size, packed to the front
+	void reallocate(std::size_t vertexCapacity, std::size_t indexCapacity);
+
+	void setupAttributes();
+
+	static GLuint s_boundVao;
+
+	GLuint m_vao;
+
+	VBO m_vertices;
+	VBO m_indices;
+	VBO m_drawIds;
+
+	FreeListAllocator m_vertexAllocator;
+	FreeListAllocator m_indexAllocator;
+
+	std::vector<Range> m_ranges;
+	std::vector<bool> m_live;
+	std::vector<Handle> m_freeHandles;
+};
\ No newline at end of file
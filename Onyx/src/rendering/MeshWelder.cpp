@@ -0,0 +1,104 @@
+#include "MeshWelder.hpp"
+
+#include "profiling\Profiler.hpp"
+
+#include <utility>
+
+MeshWelder::MeshWelder(std::size_t expectedTriangles)
+	:
+	m_expectedTriangles(expectedTriangles)
+{
+	m_indices.reserve(expectedTriangles * 3);
+}
+
+void MeshWelder::addTriangles(const Vector3f* corners, std::size_t triangleCount)
+{
+	PROFILE_FUNCTION();
+
+	if (m_lookup.empty())
+	{
+		m_lookup.reserve(m_expectedTriangles);
+	}
+
+	for (std::size_t i = 0; i < triangleCount; ++i)
+	{
+		const Vector3f* triangle = corners + i * 3;
+
+		// Area weighted, the cross product's length is twice the area
+		const Vector3f normal = (triangle[1] - triangle[0]).Cross(triangle[2] - triangle[0]);
+
+		for (std::size_t corner = 0; corner < 3; ++corner)
+		{
+			auto inserted = m_lookup.emplace(triangle[corner], static_cast<GLuint>(m_vertices.size()));
+
+			if (inserted.second)
+			{
+				m_vertices.push_back(Vertex(triangle[corner], Vector3f(0.0f, 0.0f, 0.0f)));
+			}
+
+			m_vertices[inserted.first->second].normal += normal;
+			m_indices.push_back(inserted.first->second);
+		}
+	}
+}
+
+void MeshWelder::addFacets(const Vector3f* corners, const Vector3f* normals, std::size_t triangleCount)
+{
+	PROFILE_FUNCTION();
+
+	if (m_facetLookup.empty())
+	{
+		m_facetLookup.reserve(m_expectedTriangles);
+	}
+
+	for (std::size_t i = 0; i < triangleCount; ++i)
+	{
+		const Vector3f* triangle = corners + i * 3;
+
+		Vector3f normal = normals[i];
+
+		if (normal.LengthSq() == 0.0f)
+		{
+			normal = (triangle[1] - triangle[0]).Cross(triangle[2] - triangle[0]);
+		}
+
+		if (normal.LengthSq() > 0.0f)
+		{
+			normal = normal.Normalized();
+		}
+
+		for (std::size_t corner = 0; corner < 3; ++corner)
+		{
+			const Vertex vertex(triangle[corner], normal);
+
+			auto inserted = m_facetLookup.emplace(vertex, static_cast<GLuint>(m_vertices.size()));
+
+			if (inserted.second)
+			{
+				m_vertices.push_back(vertex);
+			}
+
+			m_indices.push_back(inserted.first->second);
+		}
+	}
+}
+
+void MeshWelder::finish(std::vector<Vertex>& vertices, std::vector<GLuint>& indices)
+{
+	// Corners of only degenerate triangles have nothing to normalise
+	for (auto& vertex : m_vertices)
+	{
+		if (vertex.normal.LengthSq() > 0.0f)
+		{
+			vertex.normal = vertex.normal.Normalized();
+		}
+	}
+
+	vertices = std::move(m_vertices);
+	indices = std::move(m_indices);
+
+	m_vertices.clear();
+	m_indices.clear();
+	m_lookup.clear();
+	m_facetLookup.clear();
+}
\ No newline at end of file
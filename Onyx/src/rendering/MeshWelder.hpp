@@ -0,0 +1,84 @@
+#pragma once
+
+#include "Vertex.hpp"
+
+#include "GL\glew.h"
+
+#include "math\Vector.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+// Turns a triangle soup, e.g. from an STL file, into an indexed mesh. Corners
+// are shared when their positions are bit for bit identical, and each vertex
+// gets the area weighted normal of the triangles around it. Facets keep their
+// own normals instead, so only corners with the same normal too are shared.
+// Triangles can be added in several batches, they're welded with everything
+// of the same kind added before
+class MeshWelder
+{
+public:
+
+	// Reserves room for about this many triangles
+	MeshWelder(std::size_t expectedTriangles = 0);
+
+	// Three corners a triangle
+	void addTriangles(const Vector3f* corners, std::size_t triangleCount);
+
+	// Three corners and a normal a triangle. A zero normal is worked out from
+	// the corners, as some exporters leave it out
+	void addFacets(const Vector3f* corners, const Vector3f* normals, std::size_t triangleCount);
+
+	// Normalises the normals and hands over the vertices and indices, leaving
+	// the welder empty
+	void finish(std::vector<Vertex>& vertices, std::vector<GLuint>& indices);
+
+private:
+
+	struct PositionHash
+	{
+		std::size_t operator()(const Vector3f& p) const
+		{
+			uint32_t bits[3];
+			std::memcpy(bits, &p, sizeof(bits));
+
+			return (bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^ (bits[2] * 83492791u);
+		}
+	};
+
+	struct PositionEqual
+	{
+		bool operator()(const Vector3f& a, const Vector3f& b) const
+		{
+			return std::memcmp(&a, &b, sizeof(Vector3f)) == 0;
+		}
+	};
+
+	struct VertexHash
+	{
+		std::size_t operator()(const Vertex& v) const
+		{
+			return PositionHash()(v.position) ^ (PositionHash()(v.normal) * 31u);
+		}
+	};
+
+	struct VertexEqual
+	{
+		bool operator()(const Vertex& a, const Vertex& b) const
+		{
+			return PositionEqual()(a.position, b.position) && PositionEqual()(a.normal, b.normal);
+		}
+	};
+
+	std::size_t m_expectedTriangles;		///< Each lookup is reserved for this many on first use
+
+	std::unordered_map<Vector3f, GLuint, PositionHash, PositionEqual> m_lookup;
+
+	std::unordered_map<Vertex, GLuint, VertexHash, VertexEqual> m_facetLookup;
+
+	std::vector<Vertex> m_vertices;
+
+	std::vector<GLuint> m_indices;
+};
\ No newline at end of file
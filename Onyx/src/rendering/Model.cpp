@@ -1,175 +1,141 @@
 #include "Model.hpp"
 
-#include "Shader.hpp"
+#include "ShaderVariants.hpp"
 #include "Camera.hpp"
-
-#include <assimp/Importer.hpp>
-#include <assimp/Exporter.hpp>
-#include <assimp/scene.h>
-#include <assimp/postprocess.h>
-#include <assimp/ProgressHandler.hpp>
+#include "MeshImporter.hpp"
+#include "MeshExporter.hpp"
 
 #include "math\Ray.hpp"
 #include "math\AABB.hpp"
 
-#include <iostream>
-#include <map>
+#include "profiling\Profiler.hpp"
+#include "profiling\GpuProfiler.hpp"
 
-namespace
-{
-	std::map<std::string, Mesh::Ptr> m_meshMap;
-}
+#include <iostream>
 
 void Model::loadFromFile(const std::string& filename)
 {
-	std::map<std::string, Mesh::Ptr>::const_iterator it = m_meshMap.find(filename);
+	PROFILE_FUNCTION();
 
-	if (it != m_meshMap.end())
-	{
-		m_mesh = it->second;
+	m_mesh = MeshImporter::import(filename);
 
-		std::cout << "\nLoaded: " << filename << " from mesh map" << std::endl;
-	}
-	else
+	// A mesh from the mesh map may already be on the GPU
+	if (m_mesh && !m_mesh->isUploaded())
 	{
-		Assimp::Importer importer;
-
-		const aiScene* scene = importer.ReadFile(filename,
-			aiProcess_Triangulate |
-			aiProcess_GenSmoothNormals);
-
-		if (!scene)
-		{
-			std::cout << importer.GetErrorString() << std::endl;
-			return;
-		}
-
-		m_mesh = Mesh::create();
-		
-		const aiMesh* model = scene->mMeshes[0];
-		
-		for (unsigned int i = 0; i < model->mNumVertices; i++)
-		{
-			const aiVector3D pos = model->mVertices[i];
-			const aiVector3D norm = model->mNormals[i];
+		m_mesh->complete();
+	}
+}
 
-			Vertex vertex({ Vector3f(pos.x, pos.y, pos.z), Vector3f(norm.x, norm.y, norm.z) });
+JobSystem::Handle Model::loadFromFileAsync(const std::string& filename)
+{
+	std::shared_ptr<AsyncLoad> load = std::make_shared<AsyncLoad>();
 
-			m_mesh->addVertex(vertex);
-		}
+	load->job = JobSystem::create([load, filename]()
+	{
+		load->mesh = MeshImporter::import(filename);
 
-		for (unsigned int i = 0; i < model->mNumFaces; i++)
+		if (load->mesh)
 		{
-			const aiFace& face = model->mFaces[i];
-
-			assert(face.mNumIndices == 3);
-
-			m_mesh->addIndex(face.mIndices[0]);
-			m_mesh->addIndex(face.mIndices[1]);
-			m_mesh->addIndex(face.mIndices[2]);
+			load->bounds = load->mesh->getLocalBounds();
 		}
-	
-		m_mesh->complete();
+	});
 
-		m_mesh->bind();
-		// Vertex Positions
-		glEnableVertexAttribArray(0);
-		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)offsetof(Vertex, position));
-		// Vertex Normals
-		glEnableVertexAttribArray(1);
-		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)offsetof(Vertex, normal));
-		m_mesh->unbind();
+	m_mesh.reset();
+	m_loading = load;
+	m_placeholderBounds = AABBf(Vector3f(-0.5f, -0.5f, -0.5f), Vector3f(0.5f, 0.5f, 0.5f));
 
-		m_meshMap.insert(std::make_pair(filename, m_mesh));
+	JobSystem::run(load->job);
 
-		std::cout << "\nFinished loading: " << filename << " with " << model->mNumVertices << " vertices..." << std::endl;
-	}
+	return load->job;
 }
 
-void Model::saveToFile(const std::string& filename)
+bool Model::isLoading() const
 {
-	Assimp::Exporter exporter;
+	return m_loading != nullptr;
+}
 
-	aiScene scene;
+bool Model::finishLoading()
+{
+	if (!m_loading || !JobSystem::isFinished(m_loading->job))
+	{
+		return false;
+	}
 
-	scene.mRootNode = new aiNode();
+	m_mesh = m_loading->mesh;
 
-	scene.mMaterials = new aiMaterial*[1];
-	scene.mMaterials[0] = nullptr;
-	scene.mNumMaterials = 1;
+	if (m_mesh)
+	{
+		m_placeholderBounds = m_loading->bounds;
+	}
 
-	scene.mMaterials[0] = new aiMaterial();
+	m_loading.reset();
 
-	scene.mMeshes = new aiMesh*[1];
-	scene.mMeshes[0] = nullptr;
-	scene.mNumMeshes = 1;
+	return true;
+}
 
-	scene.mMeshes[0] = new aiMesh();
-	scene.mMeshes[0]->mMaterialIndex = 0;
+const AABBf& Model::getPlaceholderBounds() const
+{
+	return m_placeholderBounds;
+}
 
-	scene.mRootNode->mMeshes = new unsigned int[1];
-	scene.mRootNode->mMeshes[0] = 0;
-	scene.mRootNode->mNumMeshes = 1;
-		
-	auto pMesh = scene.mMeshes[0];
+void Model::setPlaceholderBounds(const AABBf& bounds)
+{
+	m_placeholderBounds = bounds;
+}
 
-	pMesh->mVertices = new aiVector3D[m_mesh->getSize()];
-	pMesh->mNumVertices = m_mesh->getSize();
-	pMesh->mPrimitiveTypes = aiPrimitiveType_TRIANGLE;
-	pMesh->mNormals = new aiVector3D[m_mesh->getSize()];
+bool Model::saveToFile(const std::string& filename) const
+{
+	PROFILE_FUNCTION();
 
-	for (size_t i = 0; i < m_mesh->getSize(); ++i)
-	{
-		Vertex v = m_mesh->operator[](i);
+	return m_mesh && MeshExporter::save(*m_mesh, filename);
+}
 
-		pMesh->mVertices[i] = aiVector3D(v.position.x, v.position.y, v.position.z);
-		pMesh->mNormals[i] = aiVector3D(v.normal.x, v.normal.y, v.normal.z);
-	}
-		
-	pMesh->mFaces = new aiFace[m_mesh->getSize() / 3];
-	pMesh->mNumFaces = m_mesh->getSize() / 3;
+void Model::render(ShaderVariants& shaders, Camera& camera, bool wireframe, unsigned int features) const
+{
+	PROFILE_FUNCTION();
 
-	for (size_t i = 0; i < m_mesh->getSize() / 3; ++i) 
+	if (!m_mesh || !m_mesh->isUploaded())
 	{
-		aiFace& face = pMesh->mFaces[i];
-
-		face.mIndices = new unsigned int[3];
-		face.mNumIndices = 3;
-
-		face.mIndices[0] = i * 3 + 0;
-		face.mIndices[1] = i * 3 + 1;
-		face.mIndices[2] = i * 3 + 2;
+		return;
 	}
 
-	const std::string extension = filename.substr(filename.find_last_of(".") + 1);
-
-	exporter.Export(&scene, extension, filename);
-}
+	Shader& shader = shaders.get(features);
 
-void Model::render(Shader& shader, Camera& camera, bool wireframe)
-{
 	// shader parameters
 	shader.setUniform("objectColour", m_colour);
 	shader.setUniform("lightColour", 1.0f, 1.0f, 1.0f);
 	shader.setUniform("lightPos", 0.5f, 1.1f, 0.8f);
-	shader.setUniform("viewPos", camera.getPosition());
-	shader.setUniform("fade", 0.0f);
-	shader.setUniform("wireframe", 1.0f);
+	shader.setUniform("viewPos", camera.getRenderPosition());
 
 	// Pass the matrices to the shader
+	const Matrix4f modelViewProjection = camera.getViewProjection() * getTransform();
+
 	shader.setUniform("modelViewMatrix", getTransform());
-	shader.setUniform("projectionMatrix", camera.getProjection());
+	shader.setUniform("modelViewProjectionMatrix", modelViewProjection);
+	shader.setUniform("normalMatrix", getInverseTransform().Transpose());
 
 	shader.bind();
 
+	GPU_PROFILE_SCOPE("Model::render");
+
 	// Draw mesh
 	m_mesh->draw(false);
 
 	if (wireframe)
 	{
-		shader.setUniform("wireframe", 0.0f);
-		shader.bind();
+		// Lines are unlit so only the position matters
+		Shader& lines = shaders.get((features & ShaderFeature::Fade) | ShaderFeature::Wireframe);
+
+		lines.setUniform("modelViewProjectionMatrix", modelViewProjection);
+
+		if (features & ShaderFeature::Fade)
+		{
+			lines.setUniform("modelViewMatrix", getTransform());
+			lines.setUniform("viewPos", camera.getRenderPosition());
+		}
+
+		lines.bind();
 
 		m_mesh->draw(true);
 	}
-}
+}
\ No newline at end of file
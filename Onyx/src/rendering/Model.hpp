@@ -3,10 +3,12 @@
 #include "Transform.hpp"
 #include "Mesh.hpp"
 
+#include "jobs\JobSystem.hpp"
+
 #include <memory>
 #include <string>
 
-class Shader;
+class ShaderVariants;
 class Camera;
 
 class Model : public Transform
@@ -25,13 +27,35 @@ public:
 		m_mesh = mesh;
 	}
 
-	Model(const Model& other) = delete;
+	// Copies share the mesh, so they're cheap enough to snapshot every tick
+	Model(const Model& other) :
+		Transform(other),
+		m_colour(other.m_colour),
+		m_mesh(other.m_mesh),
+		m_loading(other.m_loading),
+		m_placeholderBounds(other.m_placeholderBounds)
+	{}
 
-	Model& operator=(const Model& other) = delete;
+	Model& operator=(const Model& other)
+	{
+		if (this != &other)
+		{
+			Transform::operator=(other);
+			m_colour = other.m_colour;
+			m_mesh = other.m_mesh;
+			m_loading = other.m_loading;
+			m_placeholderBounds = other.m_placeholderBounds;
+		}
+
+		return *this;
+	}
 
 	Model(Model&& other) :
 		Transform(std::move(other)),
-		m_mesh(std::move(other.m_mesh))
+		m_colour(other.m_colour),
+		m_mesh(std::move(other.m_mesh)),
+		m_loading(std::move(other.m_loading)),
+		m_placeholderBounds(other.m_placeholderBounds)
 	{}
 
 	Model& operator=(Model&& other)
@@ -39,7 +63,10 @@ public:
 		if (this != &other)
 		{
 			Transform::operator=(std::move(other));
+			m_colour = other.m_colour;
 			m_mesh = std::move(other.m_mesh);
+			m_loading = std::move(other.m_loading);
+			m_placeholderBounds = other.m_placeholderBounds;
 		}
 
 		return *this;
@@ -62,7 +89,28 @@ public:
 
 	void loadFromFile(const std::string& filename);
 
-	void saveToFile(const std::string& filename);
+	// Imports on the job system and returns straight away. The model has no
+	// mesh until finishLoading() picks it up, and it's drawn as a placeholder
+	// box until the mesh has been uploaded
+	JobSystem::Handle loadFromFileAsync(const std::string& filename);
+
+	// An asynchronous load hasn't been picked up yet
+	bool isLoading() const;
+
+	// Update thread: takes the mesh once the import has finished, returns false
+	// while it's still running. The mesh is null if the import failed, and it
+	// still has to be uploaded, see GraphicSystem::upload()
+	bool finishLoading();
+
+	// A unit box until the import has finished, then the mesh's bounds
+	const AABBf& getPlaceholderBounds() const;
+
+	// For a model given a mesh that's still to be uploaded
+	void setPlaceholderBounds(const AABBf& bounds);
+
+	// Binary STL or PLY by the extension, in the model's own space. Returns
+	// false if there's no mesh or it couldn't be written
+	bool saveToFile(const std::string& filename) const;
 
 	void setColour(const Vector3f& colour)
 	{
@@ -74,16 +122,33 @@ public:
 		return m_colour;
 	}
 
+	Mesh::Ptr getMesh() const
+	{
+		return m_mesh;
+	}
+
 	void generateNormals()
 	{
 		m_mesh->updateNormals();
 	}
 
-	void render(Shader& shader, Camera& camera, bool wireframe = false);
+	// Features are ShaderFeature flags used to pick the shader variant
+	void render(ShaderVariants& shaders, Camera& camera, bool wireframe = false, unsigned int features = 0) const;
 
 private:
 
+	struct AsyncLoad
+	{
+		JobSystem::Handle job;
+		Mesh::Ptr mesh;
+		AABBf bounds;
+	};
+
 	Vector3f m_colour;
 
 	Mesh::Ptr m_mesh;
+
+	std::shared_ptr<AsyncLoad> m_loading;		///< Only read by the update thread once the job has finished
+
+	AABBf m_placeholderBounds;
 };
\ No newline at end of file
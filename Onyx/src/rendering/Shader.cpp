@@ -1,10 +1,151 @@
 #include "Shader.hpp"
 
+#include "profiling\Profiler.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <direct.h>
 #include <fstream>
+#include <iomanip>
 #include <iostream>
+#include <sstream>
+
+std::string Shader::s_binaryCacheDirectory = "./shadercache/";
 
 namespace
 {
+	const char binaryMagic[8] = { 'O', 'N', 'Y', 'X', 'P', 'R', 'O', 'G' };
+	const uint32_t binaryVersion = 1;
+
+	void hash(uint64_t& h, const char* data, std::size_t size)
+	{
+		// 64 bit FNV-1a
+		for (std::size_t i = 0; i < size; ++i)
+		{
+			h ^= static_cast<unsigned char>(data[i]);
+			h *= 1099511628211ull;
+		}
+	}
+
+	void hash(uint64_t& h, const GLubyte* string)
+	{
+		if (string)
+		{
+			hash(h, reinterpret_cast<const char*>(string), std::strlen(reinterpret_cast<const char*>(string)) + 1);
+		}
+	}
+
+	// A binary is only valid for the exact source it was built from and the
+	// driver that built it
+	uint64_t programKey(const std::vector<char>& vertexShader, const std::vector<char>& fragmentShader)
+	{
+		uint64_t h = 14695981039346656037ull;
+
+		hash(h, vertexShader.data(), vertexShader.size());
+		hash(h, fragmentShader.data(), fragmentShader.size());
+		hash(h, glGetString(GL_VENDOR));
+		hash(h, glGetString(GL_RENDERER));
+		hash(h, glGetString(GL_VERSION));
+
+		return h;
+	}
+
+	std::string binaryFilename(const std::string& directory, uint64_t key)
+	{
+		std::ostringstream filename;
+		filename << directory << std::hex << std::setw(16) << std::setfill('0') << key << ".bin";
+
+		return filename.str();
+	}
+
+	bool binariesSupported()
+	{
+		GLint formats = 0;
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+
+		return formats > 0;
+	}
+
+	bool loadBinary(GLuint program, const std::string& filename, uint64_t key)
+	{
+		std::ifstream file(filename.c_str(), std::ios_base::binary);
+
+		if (!file)
+		{
+			return false;
+		}
+
+		char magic[sizeof(binaryMagic)];
+		uint32_t version = 0;
+		uint64_t fileKey = 0;
+		uint32_t format = 0;
+		uint32_t length = 0;
+
+		file.read(magic, sizeof(magic));
+		file.read(reinterpret_cast<char*>(&version), sizeof(version));
+		file.read(reinterpret_cast<char*>(&fileKey), sizeof(fileKey));
+		file.read(reinterpret_cast<char*>(&format), sizeof(format));
+		file.read(reinterpret_cast<char*>(&length), sizeof(length));
+
+		if (!file || std::memcmp(magic, binaryMagic, sizeof(magic)) != 0 || version != binaryVersion || fileKey != key || length == 0)
+		{
+			return false;
+		}
+
+		std::vector<char> binary(length);
+		file.read(binary.data(), length);
+
+		if (!file)
+		{
+			return false;
+		}
+
+		glProgramBinary(program, format, binary.data(), length);
+
+		// The driver may still reject a binary, e.g. after an update that kept
+		// the version string
+		GLint success = GL_FALSE;
+		glGetProgramiv(program, GL_LINK_STATUS, &success);
+
+		return success == GL_TRUE;
+	}
+
+	void saveBinary(GLuint program, const std::string& directory, const std::string& filename, uint64_t key)
+	{
+		GLint length = 0;
+		glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+
+		if (length <= 0)
+		{
+			return;
+		}
+
+		std::vector<char> binary(length);
+		GLenum format = 0;
+		glGetProgramBinary(program, length, &length, &format, binary.data());
+
+		_mkdir(directory.c_str());
+
+		std::ofstream file(filename.c_str(), std::ios_base::binary | std::ios_base::trunc);
+
+		if (!file)
+		{
+			std::cout << "Failed to write shader cache file: " << filename << std::endl;
+			return;
+		}
+
+		const uint32_t format32 = format;
+		const uint32_t length32 = length;
+
+		file.write(binaryMagic, sizeof(binaryMagic));
+		file.write(reinterpret_cast<const char*>(&binaryVersion), sizeof(binaryVersion));
+		file.write(reinterpret_cast<const char*>(&key), sizeof(key));
+		file.write(reinterpret_cast<const char*>(&format32), sizeof(format32));
+		file.write(reinterpret_cast<const char*>(&length32), sizeof(length32));
+		file.write(binary.data(), length);
+	}
+
 	bool getFileContents(const std::string& filename, std::vector<char>& buffer)
 	{
 		std::ifstream file(filename.c_str(), std::ios_base::binary);
@@ -73,8 +214,70 @@ bool Shader::loadFromSource(const std::string& vertexShader, const std::string&
 	return load(std::vector<char>(vertexShader.begin(), vertexShader.end()), std::vector<char>(fragmentShader.begin(), fragmentShader.end()));
 }
 
+void Shader::setBinaryCacheDirectory(const std::string& directory)
+{
+	s_binaryCacheDirectory = directory;
+
+	if (!s_binaryCacheDirectory.empty() && s_binaryCacheDirectory.back() != '/' && s_binaryCacheDirectory.back() != '\\')
+	{
+		s_binaryCacheDirectory += '/';
+	}
+}
+
 bool Shader::load(const std::vector<char>& vertexShader, const std::vector<char>& fragmentShader)
 {
+	PROFILE_FUNCTION();
+
+	const auto start = std::chrono::high_resolution_clock::now();
+
+	const bool useCache = !s_binaryCacheDirectory.empty() && binariesSupported();
+
+	uint64_t key = 0;
+	std::string filename;
+
+	if (useCache)
+	{
+		key = programKey(vertexShader, fragmentShader);
+		filename = binaryFilename(s_binaryCacheDirectory, key);
+
+		PROFILE_SCOPE("Load program binary");
+
+		m_name = glCreateProgram();
+
+		if (loadBinary(m_name, filename, key))
+		{
+			const std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+
+			std::cout << "Loaded shader program from cache in " << elapsed.count() << "ms" << std::endl;
+
+			return true;
+		}
+
+		glDeleteProgram(m_name);
+		m_name = 0;
+	}
+
+	if (!link(vertexShader, fragmentShader, useCache))
+	{
+		return false;
+	}
+
+	if (useCache)
+	{
+		saveBinary(m_name, s_binaryCacheDirectory, filename, key);
+	}
+
+	const std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+
+	std::cout << "Compiled shader program in " << elapsed.count() << "ms" << std::endl;
+
+	return true;
+}
+
+bool Shader::link(const std::vector<char>& vertexShader, const std::vector<char>& fragmentShader, bool retrievable)
+{
+	PROFILE_FUNCTION();
+
 	GLuint frag = glCreateShader(GL_FRAGMENT_SHADER);
 	GLuint vert = glCreateShader(GL_VERTEX_SHADER);
 
@@ -88,6 +291,8 @@ bool Shader::load(const std::vector<char>& vertexShader, const std::vector<char>
 	{
 		std::cout << "Error creating shader type: Vertex" << std::endl;
 
+		glDeleteShader(frag);
+
 		return false;
 	}
 
@@ -95,9 +300,19 @@ bool Shader::load(const std::vector<char>& vertexShader, const std::vector<char>
 
 	if (!compile(fragmentShader, frag) || !compile(vertexShader, vert))
 	{
+		// Nothing should mistake the unlinked program for a usable one
+		glDeleteProgram(m_name);
+		glDeleteShader(frag);
+		glDeleteShader(vert);
+		m_name = 0;
 		return false;
 	}
 
+	if (retrievable)
+	{
+		glProgramParameteri(m_name, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	}
+
 	glLinkProgram(m_name);
 
 	//Check for errors
@@ -108,9 +323,11 @@ bool Shader::load(const std::vector<char>& vertexShader, const std::vector<char>
 	{
 		std::cout << "Error linking program: " << m_name << std::endl;
 		printProgramLog(m_name);
-		glDeleteProgram(m_name);
 		glDetachShader(m_name, frag);
 		glDetachShader(m_name, vert);
+		glDeleteProgram(m_name);
+		glDeleteShader(frag);
+		glDeleteShader(vert);
 		m_name = 0;
 		return false;
 	}
@@ -16,7 +16,8 @@ class Shader
 {
 public:
 
-	Shader()
+	Shader() :
+		m_name(0u)
 	{
 
 	}
@@ -57,6 +58,11 @@ public:
 
 	bool loadFromSource(const std::string& vertexShader, const std::string& fragmentShader);
 
+	// Linked programs are saved to this directory keyed by their source and the
+	// driver, and reloaded from there on the next run instead of recompiling.
+	// An empty string disables the cache
+	static void setBinaryCacheDirectory(const std::string& directory);
+
 	void bind()
 	{
 		glUseProgram(m_name);
@@ -274,7 +280,11 @@ private:
 
 	bool compile(const std::vector<char>& buffer, GLuint shader);
 
+	bool link(const std::vector<char>& vertexShader, const std::vector<char>& fragmentShader, bool retrievable);
+
 private:
 
 	GLuint	m_name;
+
+	static std::string s_binaryCacheDirectory;
 };
\ No newline at end of file
@@ -0,0 +1,104 @@
+#include "ShaderVariants.hpp"
+
+#include "profiling\Profiler.hpp"
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace
+{
+	const char* featureNames[ShaderFeature::Count] = { "FADE", "WIREFRAME", "FLAT_SHADING", "INDIRECT" };
+
+	bool getFileContents(const std::string& filename, std::string& contents)
+	{
+		std::ifstream file(filename.c_str(), std::ios_base::binary);
+
+		if (!file)
+		{
+			return false;
+		}
+
+		std::ostringstream stream;
+		stream << file.rdbuf();
+		contents = stream.str();
+
+		return true;
+	}
+}
+
+bool ShaderVariants::loadFromFile(const std::string& vertexShaderFilename, const std::string& fragmentShaderFilename)
+{
+	if (!getFileContents(vertexShaderFilename, m_vertexSource))
+	{
+		std::cout << "Failed to open vertex shader file: " << vertexShaderFilename << "\"" << std::endl;
+		return false;
+	}
+
+	if (!getFileContents(fragmentShaderFilename, m_fragmentSource))
+	{
+		std::cout << "Failed to open fragment shader file: " << fragmentShaderFilename << "\"" << std::endl;
+		return false;
+	}
+
+	m_variants.clear();
+
+	// The plain variant is always needed, build it now so errors show up at startup
+	return get(0).name() != 0;
+}
+
+Shader& ShaderVariants::get(unsigned int features)
+{
+	auto it = m_variants.find(features);
+
+	if (it != m_variants.end())
+	{
+		return it->second;
+	}
+
+	PROFILE_SCOPE("Compile shader variant");
+
+	// A variant that fails to build stays in the map with no program so we
+	// don't try again every draw
+	Shader& shader = m_variants[features];
+
+	if (!shader.loadFromSource(addDefines(m_vertexSource, features), addDefines(m_fragmentSource, features)))
+	{
+		std::cout << "Failed to build shader variant " << features << std::endl;
+	}
+
+	return shader;
+}
+
+std::string ShaderVariants::addDefines(const std::string& source, unsigned int features) const
+{
+	std::string defines;
+
+	for (unsigned int i = 0; i < ShaderFeature::Count; ++i)
+	{
+		if (features & (1 << i))
+		{
+			defines += std::string("#define ") + featureNames[i] + "\n";
+		}
+	}
+
+	if (defines.empty())
+	{
+		return source;
+	}
+
+	// Defines have to come after the #version directive
+	std::size_t position = source.find("#version");
+
+	if (position != std::string::npos)
+	{
+		position = source.find('\n', position);
+		position = (position == std::string::npos) ? source.size() : position + 1;
+	}
+	else
+	{
+		position = 0;
+	}
+
+	return source.substr(0, position) + defines + source.substr(position);
+}
\ No newline at end of file
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "Shader.hpp"
+
+#include <map>
+#include <string>
+#include <vector>
+
+// Features a variant can be specialised for. Each bit adds the matching
+// #define to the shader source, e.g. Fade -> #define FADE
+namespace ShaderFeature
+{
+	enum : unsigned int
+	{
+		Fade		= 1 << 0,	///< Fade out with distance from the viewer
+		Wireframe	= 1 << 1,	///< Unlit black lines
+		FlatShading	= 1 << 2,	///< Per-face normals from screen space derivatives
+		Indirect	= 1 << 3,	///< Per-draw transform and colour from a storage buffer
+
+		Count		= 4
+	};
+}
+
+// A shader compiled on demand once per combination of features, so the
+// features a draw doesn't use cost nothing per fragment
+class ShaderVariants
+{
+public:
+
+	bool loadFromFile(const std::string& vertexShaderFilename, const std::string& fragmentShaderFilename);
+
+	// Returns the program for the given ShaderFeature bitmask, compiling it on
+	// first use
+	Shader& get(unsigned int features);
+
+	std::size_t getVariantCount() const
+	{
+		return m_variants.size();
+	}
+
+private:
+
+	std::string addDefines(const std::string& source, unsigned int features) const;
+
+	std::string m_vertexSource;
+	std::string m_fragmentSource;
+
+	std::map<unsigned int, Shader> m_variants;
+};
\ No newline at end of file
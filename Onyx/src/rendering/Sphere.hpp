@@ -3,7 +3,9 @@
 #include "Transform.hpp"
 #include "Mesh.hpp"
 #include "Camera.hpp"
-#include "Shader.hpp"
+#include "ShaderVariants.hpp"
+
+#include "profiling\GpuProfiler.hpp"
 
 #include <memory>
 #include <map>
@@ -63,36 +65,31 @@ public:
 
 		m_mesh->complete();
 
-		m_mesh->bind();
-		// Vertex Positions
-		glEnableVertexAttribArray(0);
-		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), NULL);
-		// Vertex Normals
-		glEnableVertexAttribArray(1);
-		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)offsetof(Vertex, normal));
-		m_mesh->unbind();
-
 		//m_mesh->updateNormals();
 
 		setScale(radius, radius, radius);
 	}
 
-	void render(Shader& shader, Camera& camera)
+	void render(ShaderVariants& shaders, Camera& camera)
 	{
+		Shader& shader = shaders.get(0);
+
 		// shader parameters
 		shader.setUniform("objectColour", 1.0f, 0.4f, 0.4f);
 		shader.setUniform("lightColour", 1.0f, 1.0f, 1.0f);
 		shader.setUniform("lightPos", 0.5f, 20.0f, 0.5f);
-		shader.setUniform("viewPos", camera.getPosition());
-		shader.setUniform("fade", 0.0f);
+		shader.setUniform("viewPos", camera.getRenderPosition());
 
 		// Pass the matrices to the shader
 		shader.setUniform("modelViewMatrix", getTransform());
-		shader.setUniform("projectionMatrix", camera.getProjection());
+		shader.setUniform("modelViewProjectionMatrix", camera.getViewProjection() * getTransform());
+		shader.setUniform("normalMatrix", getInverseTransform().Transpose());
 
 		shader.bind();
 
 		// Draw mesh
+		GPU_PROFILE_SCOPE("Sphere::render");
+
 		m_mesh->draw(true);
 	}
 
@@ -0,0 +1,664 @@
+#include "StreamedModel.hpp"
+#include "MeshBinary.hpp"
+#include "MeshWelder.hpp"
+
+#include "profiling\Profiler.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <direct.h>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <utility>
+
+namespace
+{
+	const char fileMagic[8] = { 'O', 'N', 'Y', 'X', 'S', 'T', 'R', 'M' };
+	const uint32_t fileVersion = 1;
+
+	// Binary STL: an 80 byte header, a triangle count then 50 bytes a triangle
+	const std::size_t stlHeaderSize = 84;
+	const std::size_t stlTriangleSize = 50;
+
+	// Triangles read from the source at a time, about 50MB
+	const std::size_t chunkTriangles = 1 << 20;
+
+	// Cells are sized to hold about this many triangles, at most maxCellsPerAxis cubed
+	const uint64_t trianglesPerCell = 1 << 18;
+	const uint64_t maxCellsPerAxis = 16;
+
+	// Triangles are buffered per cell and appended to the cell's file in blocks
+	const std::size_t cellBufferSize = 64 * 1024;
+
+	// Loaded cells aren't dropped until they're this much further than the
+	// streaming distance, so moving along the edge doesn't load and unload them
+	const float unloadFactor = 1.25f;
+
+	const std::size_t maxConcurrentLoads = 4;
+
+	// A cell denser than this is welded in pieces, and only a few pieces are
+	// welded at once, so the memory partitioning takes doesn't depend on how
+	// the triangles are spread. A piece needs a few hundred MB to weld
+	const uint64_t maxWeldTriangles = 1 << 21;
+	const std::size_t maxConcurrentWelds = 4;
+
+	struct FileHeader
+	{
+		char magic[8];
+		uint32_t version;
+		uint32_t cellCount;
+		uint64_t sourceSize;
+		int64_t sourceTime;
+		uint64_t cellTableOffset;
+	};
+
+	struct CellRecord
+	{
+		float boundsMin[3];
+		float boundsMax[3];
+		uint64_t vertexOffset;
+		uint64_t vertexCount;
+		uint64_t indexOffset;
+		uint64_t indexCount;
+	};
+
+	// A triangle's corners as they're kept between passes, the normal and
+	// attribute bytes from the STL aren't needed
+	struct RawTriangle
+	{
+		Vector3f corners[3];
+	};
+
+	static_assert(sizeof(RawTriangle) == 3 * sizeof(Vector3f), "Triangles are welded as one array of corners");
+
+	// Runs function(triangles, count) over the whole file a chunk at a time
+	template <class Function>
+	bool readTriangles(std::ifstream& file, uint64_t triangleCount, Function function)
+	{
+		std::vector<char> buffer(chunkTriangles * stlTriangleSize);
+		std::vector<RawTriangle> triangles(chunkTriangles);
+
+		file.seekg(stlHeaderSize);
+
+		for (uint64_t first = 0; first < triangleCount; first += chunkTriangles)
+		{
+			const std::size_t count = static_cast<std::size_t>(std::min<uint64_t>(chunkTriangles, triangleCount - first));
+
+			if (!file.read(buffer.data(), count * stlTriangleSize))
+			{
+				return false;
+			}
+
+			// Skip each record's normal and copy the three corners
+			for (std::size_t i = 0; i < count; ++i)
+			{
+				std::memcpy(static_cast<void*>(&triangles[i]), buffer.data() + i * stlTriangleSize + sizeof(Vector3f), sizeof(RawTriangle));
+			}
+
+			function(triangles.data(), count);
+		}
+
+		return true;
+	}
+
+	std::string cellFilename(const std::string& destination, std::size_t cell)
+	{
+		return destination + "." + std::to_string(cell) + ".tmp";
+	}
+
+	bool appendFile(const std::string& filename, const std::vector<char>& data)
+	{
+		std::ofstream file(filename.c_str(), std::ios::binary | std::ios::app);
+
+		file.write(data.data(), data.size());
+
+		return static_cast<bool>(file);
+	}
+
+	void removeCellFiles(const std::string& destination, std::size_t cellCount)
+	{
+		for (std::size_t cell = 0; cell < cellCount; ++cell)
+		{
+			std::remove(cellFilename(destination, cell).c_str());
+		}
+	}
+
+	float distanceSquared(const Vector3f& point, const AABBf& bounds)
+	{
+		const Vector3f closest = point.Max(bounds.min).Min(bounds.max);
+		const Vector3f offset = point - closest;
+
+		return offset.Dot(offset);
+	}
+
+	bool readHeader(std::ifstream& file, const MeshBinary::Key& key, FileHeader& header)
+	{
+		return file.read(reinterpret_cast<char*>(&header), sizeof(header)) &&
+			std::memcmp(header.magic, fileMagic, sizeof(fileMagic)) == 0 &&
+			header.version == fileVersion &&
+			header.sourceSize == key.sourceSize &&
+			header.sourceTime == key.sourceTime;
+	}
+}
+
+StreamedModel::StreamedModel()
+	:
+	m_streamingDistance(2.0f),
+	m_maxLoadedCells(64),
+	m_colour(1.0f, 1.0f, 1.0f)
+{
+}
+
+StreamedModel::~StreamedModel()
+{
+	waitForJobs();
+}
+
+void StreamedModel::open(const std::string& filename)
+{
+	// A previous file's jobs still write to the cells
+	waitForJobs();
+
+	m_cells.clear();
+
+	m_preparing = JobSystem::create([this, filename]() { prepare(filename); });
+
+	JobSystem::run(m_preparing);
+}
+
+void StreamedModel::waitForJobs()
+{
+	if (m_preparing)
+	{
+		JobSystem::wait(m_preparing);
+	}
+
+	for (auto& cell : m_cells)
+	{
+		if (cell.job)
+		{
+			JobSystem::wait(cell.job);
+		}
+	}
+}
+
+bool StreamedModel::isReady() const
+{
+	return m_preparing && JobSystem::isFinished(m_preparing);
+}
+
+void StreamedModel::setStreamingDistance(float distance)
+{
+	m_streamingDistance = distance;
+}
+
+void StreamedModel::setMaxLoadedCells(std::size_t cells)
+{
+	m_maxLoadedCells = cells;
+}
+
+void StreamedModel::prepare(const std::string& filename)
+{
+	PROFILE_FUNCTION();
+
+	MeshBinary::Key key;
+
+	if (!MeshBinary::makeKey(filename, 0, key))
+	{
+		std::cout << "Failed to open " << filename << std::endl;
+		return;
+	}
+
+	// Kept with the mesh cache if there is one, otherwise next to the source
+	if (MeshBinary::isEnabled())
+	{
+		_mkdir(MeshBinary::getCacheDirectory().c_str());
+
+		m_partitionFilename = MeshBinary::getCacheFilename(key, "onyxstream");
+	}
+	else
+	{
+		m_partitionFilename = filename + ".onyxstream";
+	}
+
+	FileHeader header;
+
+	{
+		std::ifstream file(m_partitionFilename.c_str(), std::ios::binary);
+
+		if (!file || !readHeader(file, key, header))
+		{
+			file.close();
+
+			std::cout << "\nPartitioning " << filename << " for streaming..." << std::endl;
+
+			if (!partition(filename, m_partitionFilename))
+			{
+				std::cout << "Failed to partition " << filename << ", only binary STL files can be streamed" << std::endl;
+				return;
+			}
+		}
+	}
+
+	std::ifstream file(m_partitionFilename.c_str(), std::ios::binary);
+
+	if (!file || !readHeader(file, key, header))
+	{
+		return;
+	}
+
+	std::vector<CellRecord> records(header.cellCount);
+
+	file.seekg(header.cellTableOffset);
+	file.read(reinterpret_cast<char*>(records.data()), records.size() * sizeof(CellRecord));
+
+	if (!file)
+	{
+		return;
+	}
+
+	std::vector<Cell> cells(records.size());
+
+	for (std::size_t i = 0; i < records.size(); ++i)
+	{
+		const CellRecord& record = records[i];
+
+		cells[i].bounds = AABBf(Vector3f(record.boundsMin[0], record.boundsMin[1], record.boundsMin[2]),
+			Vector3f(record.boundsMax[0], record.boundsMax[1], record.boundsMax[2]));
+		cells[i].vertexOffset = record.vertexOffset;
+		cells[i].vertexCount = record.vertexCount;
+		cells[i].indexOffset = record.indexOffset;
+		cells[i].indexCount = record.indexCount;
+	}
+
+	m_cells.swap(cells);
+
+	std::cout << "\nStreaming " << filename << " in " << m_cells.size() << " cells" << std::endl;
+}
+
+bool StreamedModel::partition(const std::string& source, const std::string& destination)
+{
+	PROFILE_FUNCTION();
+
+	MeshBinary::Key key;
+
+	if (!MeshBinary::makeKey(source, 0, key))
+	{
+		return false;
+	}
+
+	std::ifstream file(source.c_str(), std::ios::binary);
+
+	char stlHeader[stlHeaderSize];
+
+	if (!file || !file.read(stlHeader, stlHeaderSize))
+	{
+		return false;
+	}
+
+	uint32_t triangleCount = 0;
+	std::memcpy(&triangleCount, stlHeader + 80, sizeof(triangleCount));
+
+	// An ASCII STL won't happen to be exactly the right size
+	if (key.sourceSize != stlHeaderSize + uint64_t(triangleCount) * stlTriangleSize || triangleCount == 0)
+	{
+		return false;
+	}
+
+	// First pass: the bounds, to lay the grid out over
+	AABBf bounds;
+
+	{
+		PROFILE_SCOPE("Bounds");
+
+		if (!readTriangles(file, triangleCount, [&bounds](const RawTriangle* triangles, std::size_t count)
+		{
+			for (std::size_t i = 0; i < count; ++i)
+			{
+				for (auto& corner : triangles[i].corners)
+				{
+					bounds.include(corner);
+				}
+			}
+		}))
+		{
+			return false;
+		}
+	}
+
+	const uint64_t cellsNeeded = (triangleCount + trianglesPerCell - 1) / trianglesPerCell;
+	const uint64_t cellsPerAxis = std::min(maxCellsPerAxis, std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(std::cbrt(double(cellsNeeded))))));
+	const std::size_t cellCount = static_cast<std::size_t>(cellsPerAxis * cellsPerAxis * cellsPerAxis);
+
+	const Vector3f size = bounds.max - bounds.min;
+
+	// Flat axes would divide by zero, everything on them goes in the first cell
+	const Vector3f scale(size.x > 0.0f ? cellsPerAxis / size.x : 0.0f,
+		size.y > 0.0f ? cellsPerAxis / size.y : 0.0f,
+		size.z > 0.0f ? cellsPerAxis / size.z : 0.0f);
+
+	// Second pass: append each triangle to the file of the cell holding its centre.
+	// Cell files left behind by a partition that didn't finish would be appended to
+	std::vector<uint64_t> cellTriangles(cellCount, 0);
+
+	removeCellFiles(destination, cellCount);
+
+	{
+		PROFILE_SCOPE("Bin triangles");
+
+		std::vector<std::vector<char>> buffers(cellCount);
+		bool written = true;
+
+		const bool read = readTriangles(file, triangleCount, [&](const RawTriangle* triangles, std::size_t count)
+		{
+			for (std::size_t i = 0; i < count; ++i)
+			{
+				const RawTriangle& triangle = triangles[i];
+
+				const Vector3f centre = (triangle.corners[0] + triangle.corners[1] + triangle.corners[2]) / 3.0f;
+
+				const uint64_t x = std::min(cellsPerAxis - 1, static_cast<uint64_t>(std::max(0.0f, (centre.x - bounds.min.x) * scale.x)));
+				const uint64_t y = std::min(cellsPerAxis - 1, static_cast<uint64_t>(std::max(0.0f, (centre.y - bounds.min.y) * scale.y)));
+				const uint64_t z = std::min(cellsPerAxis - 1, static_cast<uint64_t>(std::max(0.0f, (centre.z - bounds.min.z) * scale.z)));
+
+				const std::size_t cell = static_cast<std::size_t>((z * cellsPerAxis + y) * cellsPerAxis + x);
+
+				std::vector<char>& buffer = buffers[cell];
+
+				const char* bytes = reinterpret_cast<const char*>(&triangle);
+				buffer.insert(buffer.end(), bytes, bytes + sizeof(RawTriangle));
+
+				cellTriangles[cell]++;
+
+				if (buffer.size() >= cellBufferSize)
+				{
+					written = appendFile(cellFilename(destination, cell), buffer) && written;
+					buffer.clear();
+				}
+			}
+		});
+
+		for (std::size_t cell = 0; cell < cellCount; ++cell)
+		{
+			if (!buffers[cell].empty())
+			{
+				written = appendFile(cellFilename(destination, cell), buffers[cell]) && written;
+			}
+		}
+
+		if (!read || !written)
+		{
+			removeCellFiles(destination, cellCount);
+			return false;
+		}
+	}
+
+	// Third pass: weld the cells a few pieces at a time, a piece being a whole
+	// cell or part of a dense one. Each piece gets its own record, its bounds
+	// are still within the cell's
+	struct WeldPiece
+	{
+		std::size_t cell;
+		uint64_t first;
+		uint64_t count;
+	};
+
+	std::vector<WeldPiece> pieces;
+
+	for (std::size_t cell = 0; cell < cellCount; ++cell)
+	{
+		for (uint64_t first = 0; first < cellTriangles[cell]; first += maxWeldTriangles)
+		{
+			pieces.push_back({ cell, first, std::min(maxWeldTriangles, cellTriangles[cell] - first) });
+		}
+	}
+
+	const std::string temporary = destination + ".tmp";
+
+	std::ofstream output(temporary.c_str(), std::ios::binary | std::ios::trunc);
+
+	if (!output)
+	{
+		removeCellFiles(destination, cellCount);
+		return false;
+	}
+
+	FileHeader header = {};
+
+	std::memcpy(header.magic, fileMagic, sizeof(fileMagic));
+	header.version = fileVersion;
+	header.sourceSize = key.sourceSize;
+	header.sourceTime = key.sourceTime;
+
+	output.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+	std::mutex outputMutex;
+	std::vector<CellRecord> records;
+
+	std::atomic<bool> failed(false);
+	std::atomic<std::size_t> nextPiece(0);
+
+	{
+		PROFILE_SCOPE("Weld cells");
+
+		// Each job takes pieces until there are none left
+		JobSystem::parallelFor(0, std::min(pieces.size(), maxConcurrentWelds), 1, [&](std::size_t, std::size_t)
+		{
+			for (std::size_t i = nextPiece++; i < pieces.size() && !failed; i = nextPiece++)
+			{
+				const WeldPiece& piece = pieces[i];
+
+				std::vector<RawTriangle> triangles(static_cast<std::size_t>(piece.count));
+
+				bool complete;
+
+				{
+					std::ifstream cellFile(cellFilename(destination, piece.cell).c_str(), std::ios::binary);
+
+					cellFile.seekg(piece.first * sizeof(RawTriangle));
+					cellFile.read(reinterpret_cast<char*>(triangles.data()), triangles.size() * sizeof(RawTriangle));
+
+					complete = static_cast<bool>(cellFile);
+				}
+
+				// A short read would weld zeroed triangles into the cell
+				if (!complete)
+				{
+					failed = true;
+					break;
+				}
+
+				std::vector<Vertex> vertices;
+				std::vector<GLuint> indices;
+
+				MeshWelder welder(triangles.size());
+				welder.addTriangles(triangles.front().corners, triangles.size());
+				welder.finish(vertices, indices);
+
+				std::vector<RawTriangle>().swap(triangles);
+
+				CellRecord record;
+
+				AABBf cellBounds;
+
+				for (auto& vertex : vertices)
+				{
+					cellBounds.include(vertex.position);
+				}
+
+				record.boundsMin[0] = cellBounds.min.x;
+				record.boundsMin[1] = cellBounds.min.y;
+				record.boundsMin[2] = cellBounds.min.z;
+				record.boundsMax[0] = cellBounds.max.x;
+				record.boundsMax[1] = cellBounds.max.y;
+				record.boundsMax[2] = cellBounds.max.z;
+				record.vertexCount = vertices.size();
+				record.indexCount = indices.size();
+
+				std::lock_guard<std::mutex> lock(outputMutex);
+
+				record.vertexOffset = static_cast<uint64_t>(output.tellp());
+				output.write(reinterpret_cast<const char*>(vertices.data()), vertices.size() * sizeof(Vertex));
+
+				record.indexOffset = static_cast<uint64_t>(output.tellp());
+				output.write(reinterpret_cast<const char*>(indices.data()), indices.size() * sizeof(GLuint));
+
+				records.push_back(record);
+			}
+		});
+	}
+
+	removeCellFiles(destination, cellCount);
+
+	if (failed)
+	{
+		output.close();
+		std::remove(temporary.c_str());
+		return false;
+	}
+
+	header.cellCount = static_cast<uint32_t>(records.size());
+	header.cellTableOffset = static_cast<uint64_t>(output.tellp());
+
+	output.write(reinterpret_cast<const char*>(records.data()), records.size() * sizeof(CellRecord));
+
+	output.seekp(0);
+	output.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+	output.close();
+
+	if (!output)
+	{
+		std::remove(temporary.c_str());
+		return false;
+	}
+
+	std::remove(destination.c_str());
+
+	return std::rename(temporary.c_str(), destination.c_str()) == 0;
+}
+
+Mesh::Ptr StreamedModel::loadCell(const Cell& cell) const
+{
+	PROFILE_FUNCTION();
+
+	std::ifstream file(m_partitionFilename.c_str(), std::ios::binary);
+
+	std::vector<Vertex> vertices(static_cast<std::size_t>(cell.vertexCount));
+	std::vector<GLuint> indices(static_cast<std::size_t>(cell.indexCount));
+
+	file.seekg(cell.vertexOffset);
+	file.read(reinterpret_cast<char*>(vertices.data()), vertices.size() * sizeof(Vertex));
+
+	file.seekg(cell.indexOffset);
+	file.read(reinterpret_cast<char*>(indices.data()), indices.size() * sizeof(GLuint));
+
+	if (!file)
+	{
+		return nullptr;
+	}
+
+	Mesh::Ptr mesh = Mesh::create();
+
+	mesh->addVertices(std::move(vertices));
+	mesh->addIndices(std::move(indices));
+
+	return mesh;
+}
+
+void StreamedModel::update(const Vector3f& viewerPosition, std::vector<Mesh::Ptr>& uploads, std::vector<Mesh::Ptr>& releases)
+{
+	PROFILE_FUNCTION();
+
+	if (!isReady())
+	{
+		return;
+	}
+
+	const Vector3f viewer = getInverseTransform().transformPoint(viewerPosition);
+
+	const float loadDistance = m_streamingDistance * m_streamingDistance;
+	const float unloadDistance = loadDistance * unloadFactor * unloadFactor;
+
+	std::size_t resident = 0;
+	std::size_t loading = 0;
+
+	std::vector<std::pair<float, std::size_t>> wanted;
+
+	for (std::size_t i = 0; i < m_cells.size(); ++i)
+	{
+		Cell& cell = m_cells[i];
+
+		const float distance = distanceSquared(viewer, cell.bounds);
+
+		if (cell.state == CellState::Loading && JobSystem::isFinished(cell.job))
+		{
+			cell.job.reset();
+			cell.state = cell.mesh ? CellState::Loaded : CellState::Unloaded;
+
+			if (cell.mesh)
+			{
+				uploads.push_back(cell.mesh);
+			}
+		}
+
+		if (cell.state == CellState::Loaded && distance > unloadDistance)
+		{
+			releases.push_back(std::move(cell.mesh));
+			cell.mesh.reset();
+			cell.state = CellState::Unloaded;
+		}
+
+		if (cell.state == CellState::Unloaded && distance <= loadDistance)
+		{
+			wanted.emplace_back(distance, i);
+		}
+
+		resident += cell.state != CellState::Unloaded ? 1 : 0;
+		loading += cell.state == CellState::Loading ? 1 : 0;
+	}
+
+	std::sort(wanted.begin(), wanted.end());
+
+	for (auto& candidate : wanted)
+	{
+		if (loading >= maxConcurrentLoads || resident >= m_maxLoadedCells)
+		{
+			break;
+		}
+
+		Cell& cell = m_cells[candidate.second];
+
+		cell.state = CellState::Loading;
+		cell.job = JobSystem::create([this, &cell]() { cell.mesh = loadCell(cell); });
+
+		JobSystem::run(cell.job);
+
+		loading++;
+		resident++;
+	}
+}
+
+void StreamedModel::getModels(std::vector<Model>& models, std::vector<AABBf>& bounds) const
+{
+	for (auto& cell : m_cells)
+	{
+		if (cell.state != CellState::Loaded)
+		{
+			continue;
+		}
+
+		Model model(cell.mesh);
+
+		static_cast<Transform&>(model) = *this;
+		model.setColour(m_colour);
+		model.setPlaceholderBounds(cell.bounds);
+
+		models.push_back(std::move(model));
+		bounds.push_back(cell.bounds);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,112 @@
+#pragma once
+
+#include "Transform.hpp"
+#include "Model.hpp"
+#include "Mesh.hpp"
+
+#include "jobs\JobSystem.hpp"
+
+#include "math\AABB.hpp"
+#include "math\Vector.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// A binary STL too big to load in one go, e.g. a multi gigabyte scan. The first
+// time a file is opened it's split on disk into a grid of cells, each welded
+// into an indexed mesh of its own, see partition(). From then on only the
+// cells near the viewer are read and uploaded, nearest first, and cells left
+// behind are released again, so memory use depends on the streaming distance
+// rather than the size of the file
+class StreamedModel : public Transform
+{
+public:
+
+	StreamedModel();
+
+	// Waits for any cells still loading
+	~StreamedModel();
+
+	StreamedModel(const StreamedModel& other) = delete;
+
+	StreamedModel& operator=(const StreamedModel& other) = delete;
+
+	// Starts partitioning the file on the job system if that hasn't been done
+	// already, nothing streams until it's finished
+	void open(const std::string& filename);
+
+	bool isReady() const;
+
+	// Cells closer than this to the viewer, in the model's own units, are loaded
+	void setStreamingDistance(float distance);
+
+	void setMaxLoadedCells(std::size_t cells);
+
+	void setColour(const Vector3f& colour)
+	{
+		m_colour = colour;
+	}
+
+	// Update thread: start loading cells that came into range and pick up the
+	// ones that finished. Meshes to upload and meshes that fell out of range are
+	// appended, for the GraphicSystem to upload and release
+	void update(const Vector3f& viewerPosition, std::vector<Mesh::Ptr>& uploads, std::vector<Mesh::Ptr>& releases);
+
+	// Update thread: a model for each loaded cell and its local bounds
+	void getModels(std::vector<Model>& models, std::vector<AABBf>& bounds) const;
+
+	// Split a binary STL into a uniform grid of cells over its bounds, with
+	// enough cells for the triangle count if they were spread evenly, so dense
+	// areas end up with more triangles per cell. The file is read a fixed
+	// number of triangles at a time so the whole of it is never in memory.
+	// Triangles go to the cell holding their centre, so vertices are only
+	// welded with others in the same cell. Dense cells are welded in pieces of
+	// bounded size, a few at a time, so memory use stays bounded too. Returns
+	// false if the source isn't a binary STL or the destination can't be written
+	static bool partition(const std::string& source, const std::string& destination);
+
+private:
+
+	enum class CellState
+	{
+		Unloaded,
+		Loading,
+		Loaded
+	};
+
+	struct Cell
+	{
+		AABBf bounds;
+
+		uint64_t vertexOffset = 0;
+		uint64_t vertexCount = 0;
+		uint64_t indexOffset = 0;
+		uint64_t indexCount = 0;
+
+		CellState state = CellState::Unloaded;
+
+		JobSystem::Handle job;
+		Mesh::Ptr mesh;				///< Set by the job, only read once it's finished
+	};
+
+	void prepare(const std::string& filename);
+
+	// Until preparing and every cell load has finished
+	void waitForJobs();
+
+	Mesh::Ptr loadCell(const Cell& cell) const;
+
+	std::string m_partitionFilename;
+
+	JobSystem::Handle m_preparing;	///< Fills in the cells, which aren't touched until it's finished
+
+	std::vector<Cell> m_cells;
+
+	float m_streamingDistance;
+
+	std::size_t m_maxLoadedCells;
+
+	Vector3f m_colour;
+};
\ No newline at end of file
@@ -0,0 +1,816 @@
+#include "TextMeshParser.hpp"
+#include "MeshWelder.hpp"
+
+#include "jobs\JobSystem.hpp"
+
+#include "profiling\Profiler.hpp"
+
+#include "Utilities.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <unordered_map>
+
+namespace
+{
+	// Each job parses a chunk about this size
+	const std::size_t chunkBytes = 4 * 1024 * 1024;
+
+	const std::size_t stlHeaderSize = 84;
+	const std::size_t stlTriangleSize = 50;
+
+	const GLuint noIndex = std::numeric_limits<GLuint>::max();
+
+	// The largest float plus half a unit in its last place, the smallest
+	// double that rounds to infinity
+	const double floatOverflow = 0x1.ffffffp127;
+
+	// Every power of ten a double holds exactly
+	const double powersOfTen[] =
+	{
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+	};
+
+	inline bool isSpace(char c)
+	{
+		return c == ' ' || c == '\t' || c == '\r';
+	}
+
+	inline bool isDigit(char c)
+	{
+		return static_cast<unsigned char>(c - '0') < 10;
+	}
+
+	inline const char* skipSpace(const char* cursor, const char* end)
+	{
+		while (cursor != end && isSpace(*cursor))
+		{
+			++cursor;
+		}
+
+		return cursor;
+	}
+
+	// Whether the text at cursor is the keyword followed by a space or the end
+	inline bool isKeyword(const char* cursor, const char* end, const char* keyword, std::size_t length)
+	{
+		return std::size_t(end - cursor) >= length && std::memcmp(cursor, keyword, length) == 0 &&
+			(cursor + length == end || isSpace(cursor[length]) || cursor[length] == '\n');
+	}
+
+	// Parses a float at cursor and moves past it. A decimal with at most 19
+	// significant digits and a small exponent, which is nearly every number
+	// in a model file, is converted with one multiply or divide of exact
+	// doubles. Anything else goes through from_chars. Either way the double is
+	// then rounded to a float, just as atof and a cast would
+	bool parseFloat(const char*& cursor, const char* end, float& value)
+	{
+		const char* p = skipSpace(cursor, end);
+
+		// from_chars doesn't take a plus sign
+		const char* number = (p != end && *p == '+') ? p + 1 : p;
+
+		bool negative = false;
+
+		if (p != end && (*p == '-' || *p == '+'))
+		{
+			negative = (*p == '-');
+			++p;
+		}
+
+		uint64_t mantissa = 0;
+		int digits = 0;
+		int exponent = 0;
+		bool exact = true;
+		bool any = false;
+
+		for (; p != end && isDigit(*p); ++p)
+		{
+			any = true;
+
+			if (digits < 19)
+			{
+				mantissa = mantissa * 10 + (*p - '0');
+				digits += (mantissa != 0);
+			}
+			else
+			{
+				exact = false;
+			}
+		}
+
+		if (p != end && *p == '.')
+		{
+			for (++p; p != end && isDigit(*p); ++p)
+			{
+				any = true;
+
+				if (digits < 19)
+				{
+					mantissa = mantissa * 10 + (*p - '0');
+					digits += (mantissa != 0);
+					exponent--;
+				}
+				else
+				{
+					exact = false;
+				}
+			}
+		}
+
+		if (!any)
+		{
+			return false;
+		}
+
+		if (p != end && (*p == 'e' || *p == 'E'))
+		{
+			++p;
+
+			bool negativeExponent = false;
+
+			if (p != end && (*p == '-' || *p == '+'))
+			{
+				negativeExponent = (*p == '-');
+				++p;
+			}
+
+			if (p == end || !isDigit(*p))
+			{
+				return false;
+			}
+
+			int written = 0;
+
+			for (; p != end && isDigit(*p); ++p)
+			{
+				written = written < 10000 ? written * 10 + (*p - '0') : written;
+			}
+
+			exponent += negativeExponent ? -written : written;
+		}
+
+		double result;
+
+		if (exact && mantissa <= (uint64_t(1) << 53) && exponent >= -22 && exponent <= 22)
+		{
+			result = static_cast<double>(mantissa);
+			result = exponent < 0 ? result / powersOfTen[-exponent] : result * powersOfTen[exponent];
+			result = negative ? -result : result;
+		}
+		else if (!Util::fromChars(std::string_view(number, p - number), result))
+		{
+			return false;
+		}
+
+		// Too small for a float comes out as zero, too big as infinity. Casting
+		// an out of range double is undefined, so only what would round past
+		// the largest float is made infinite here, the rest rounds as a cast would
+		if (std::abs(result) >= floatOverflow)
+		{
+			result = result < 0.0 ? -std::numeric_limits<double>::infinity() : std::numeric_limits<double>::infinity();
+		}
+
+		value = static_cast<float>(result);
+
+		cursor = p;
+
+		return true;
+	}
+
+	bool parseVector(const char*& cursor, const char* end, Vector3f& vector)
+	{
+		return parseFloat(cursor, end, vector.x) && parseFloat(cursor, end, vector.y) && parseFloat(cursor, end, vector.z);
+	}
+
+	bool parseInteger(const char*& cursor, const char* end, int64_t& value)
+	{
+		const char* p = cursor;
+
+		const bool negative = (p != end && *p == '-');
+
+		if (negative)
+		{
+			++p;
+		}
+
+		if (p == end || !isDigit(*p))
+		{
+			return false;
+		}
+
+		int64_t result = 0;
+
+		for (; p != end && isDigit(*p); ++p)
+		{
+			if (result > (std::numeric_limits<int64_t>::max() - 9) / 10)
+			{
+				return false;
+			}
+
+			result = result * 10 + (*p - '0');
+		}
+
+		value = negative ? -result : result;
+		cursor = p;
+
+		return true;
+	}
+
+	// Runs function(lineBegin, lineEnd) over every line, newlines are found 16
+	// characters at a time
+	template <class Function>
+	bool forEachLine(std::string_view text, Function function)
+	{
+		const char* cursor = text.data();
+		const char* end = cursor + text.size();
+
+		while (cursor != end)
+		{
+			const char* lineEnd = cursor + Util::find(std::string_view(cursor, end - cursor), '\n');
+
+			if (!function(skipSpace(cursor, lineEnd), lineEnd))
+			{
+				return false;
+			}
+
+			cursor = (lineEnd == end) ? end : lineEnd + 1;
+		}
+
+		return true;
+	}
+
+	// Chunks of about chunkBytes that end just after a line. If there's a
+	// terminator the chunks end on the line holding it, so no record is split
+	std::vector<std::string_view> splitChunks(std::string_view text, std::string_view terminator)
+	{
+		std::vector<std::string_view> chunks;
+
+		std::size_t first = 0;
+
+		while (first < text.size())
+		{
+			std::size_t last = first + chunkBytes;
+
+			if (last >= text.size())
+			{
+				last = text.size();
+			}
+			else
+			{
+				if (!terminator.empty())
+				{
+					last = std::min(text.find(terminator, last), text.size());
+				}
+
+				last = std::min(last + Util::find(text.substr(last), '\n') + 1, text.size());
+			}
+
+			chunks.push_back(text.substr(first, last - first));
+
+			first = last;
+		}
+
+		return chunks;
+	}
+
+	bool parseStlChunk(std::string_view text, std::vector<Vector3f>& corners, std::vector<Vector3f>& normals)
+	{
+		const bool parsed = forEachLine(text, [&corners, &normals](const char* cursor, const char* end)
+		{
+			if (isKeyword(cursor, end, "facet", 5))
+			{
+				cursor = skipSpace(cursor + 5, end);
+
+				// A facet without a normal gets one from its corners when welded
+				Vector3f normal(0.0f, 0.0f, 0.0f);
+
+				if (isKeyword(cursor, end, "normal", 6))
+				{
+					cursor += 6;
+
+					if (!parseVector(cursor, end, normal))
+					{
+						return false;
+					}
+				}
+
+				normals.push_back(normal);
+
+				return true;
+			}
+
+			if (!isKeyword(cursor, end, "vertex", 6))
+			{
+				return true;
+			}
+
+			cursor += 6;
+
+			Vector3f corner;
+
+			if (!parseVector(cursor, end, corner))
+			{
+				return false;
+			}
+
+			corners.push_back(corner);
+
+			return true;
+		});
+
+		// Chunks end on a facet, so they only hold whole triangles
+		return parsed && corners.size() == normals.size() * 3;
+	}
+
+	// Negative indices count back from the last vertex read, which can only be
+	// resolved once it's known how many vertices the chunks before hold
+	struct RelativeIndex
+	{
+		std::size_t corner;
+		int64_t index;					///< From the start of the chunk, negative if it's in an earlier chunk
+	};
+
+	struct ObjChunk
+	{
+		std::vector<Vector3f> positions;
+		std::vector<Vector3f> normals;
+
+		std::vector<GLuint> corners;			///< Position index of each triangle corner
+		std::vector<GLuint> cornerNormals;		///< Normal index of each corner, noIndex if it hasn't one
+
+		std::vector<RelativeIndex> relativeCorners;
+		std::vector<RelativeIndex> relativeNormals;
+
+		std::size_t positionBase = 0;
+		std::size_t normalBase = 0;
+	};
+
+	struct FaceVertex
+	{
+		int64_t position;				///< Absolute if relativePosition is false
+		int64_t normal;
+		bool relativePosition;
+		bool relativeNormal;
+		bool hasNormal;
+	};
+
+	// An index as written is one based, or negative to count back from the last
+	inline bool resolveIndex(int64_t written, std::size_t readSoFar, int64_t& index, bool& relative)
+	{
+		if (written == 0)
+		{
+			return false;
+		}
+
+		relative = written < 0;
+		index = relative ? int64_t(readSoFar) + written : written - 1;
+
+		return relative || index < int64_t(noIndex);
+	}
+
+	// v/vt/vn, v//vn, v/vt or v
+	bool parseFaceVertex(const char*& cursor, const char* end, const ObjChunk& chunk, FaceVertex& vertex)
+	{
+		int64_t written;
+
+		if (!parseInteger(cursor, end, written) || !resolveIndex(written, chunk.positions.size(), vertex.position, vertex.relativePosition))
+		{
+			return false;
+		}
+
+		vertex.hasNormal = false;
+
+		if (cursor != end && *cursor == '/')
+		{
+			++cursor;
+
+			// Texture coordinates aren't used
+			int64_t unused;
+
+			if (cursor != end && *cursor != '/' && !parseInteger(cursor, end, unused))
+			{
+				return false;
+			}
+
+			if (cursor != end && *cursor == '/')
+			{
+				++cursor;
+
+				if (!parseInteger(cursor, end, written) || !resolveIndex(written, chunk.normals.size(), vertex.normal, vertex.relativeNormal))
+				{
+					return false;
+				}
+
+				vertex.hasNormal = true;
+			}
+		}
+
+		return cursor == end || isSpace(*cursor);
+	}
+
+	void addCorner(ObjChunk& chunk, const FaceVertex& vertex)
+	{
+		if (vertex.relativePosition)
+		{
+			chunk.relativeCorners.push_back({ chunk.corners.size(), vertex.position });
+		}
+
+		if (vertex.hasNormal && vertex.relativeNormal)
+		{
+			chunk.relativeNormals.push_back({ chunk.cornerNormals.size(), vertex.normal });
+		}
+
+		chunk.corners.push_back(vertex.relativePosition ? noIndex : static_cast<GLuint>(vertex.position));
+		chunk.cornerNormals.push_back(vertex.hasNormal && !vertex.relativeNormal ? static_cast<GLuint>(vertex.normal) : noIndex);
+	}
+
+	bool parseObjChunk(std::string_view text, ObjChunk& chunk)
+	{
+		std::vector<FaceVertex> face;
+
+		return forEachLine(text, [&chunk, &face](const char* cursor, const char* end)
+		{
+			if (isKeyword(cursor, end, "v", 1))
+			{
+				Vector3f position;
+
+				cursor += 1;
+
+				if (!parseVector(cursor, end, position))
+				{
+					return false;
+				}
+
+				chunk.positions.push_back(position);
+			}
+			else if (isKeyword(cursor, end, "vn", 2))
+			{
+				Vector3f normal;
+
+				cursor += 2;
+
+				if (!parseVector(cursor, end, normal))
+				{
+					return false;
+				}
+
+				chunk.normals.push_back(normal);
+			}
+			else if (isKeyword(cursor, end, "f", 1))
+			{
+				face.clear();
+
+				for (cursor = skipSpace(cursor + 1, end); cursor != end; cursor = skipSpace(cursor, end))
+				{
+					FaceVertex vertex;
+
+					if (!parseFaceVertex(cursor, end, chunk, vertex))
+					{
+						return false;
+					}
+
+					face.push_back(vertex);
+				}
+
+				if (face.size() < 3)
+				{
+					return false;
+				}
+
+				// Triangulated as a fan around the first corner
+				for (std::size_t i = 1; i + 1 < face.size(); ++i)
+				{
+					addCorner(chunk, face[0]);
+					addCorner(chunk, face[i]);
+					addCorner(chunk, face[i + 1]);
+				}
+			}
+
+			// Comments, texture coordinates, groups, materials and anything
+			// else are skipped
+			return true;
+		});
+	}
+
+	// Fills in the indices that count back, and checks every index is in range
+	bool resolveChunk(ObjChunk& chunk, std::size_t positionCount, std::size_t normalCount)
+	{
+		for (const RelativeIndex& relative : chunk.relativeCorners)
+		{
+			const int64_t index = int64_t(chunk.positionBase) + relative.index;
+
+			if (index < 0)
+			{
+				return false;
+			}
+
+			chunk.corners[relative.corner] = static_cast<GLuint>(index);
+		}
+
+		for (const RelativeIndex& relative : chunk.relativeNormals)
+		{
+			const int64_t index = int64_t(chunk.normalBase) + relative.index;
+
+			if (index < 0)
+			{
+				return false;
+			}
+
+			chunk.cornerNormals[relative.corner] = static_cast<GLuint>(index);
+		}
+
+		for (GLuint corner : chunk.corners)
+		{
+			if (corner >= positionCount)
+			{
+				return false;
+			}
+		}
+
+		for (GLuint normal : chunk.cornerNormals)
+		{
+			if (normal != noIndex && normal >= normalCount)
+			{
+				return false;
+			}
+		}
+
+		return true;
+	}
+}
+
+bool TextMeshParser::canParse(const std::string& extension, std::string_view text)
+{
+	if (extension == "obj")
+	{
+		return true;
+	}
+
+	if (extension != "stl")
+	{
+		return false;
+	}
+
+	if (text.size() >= stlHeaderSize)
+	{
+		uint32_t triangleCount;
+		std::memcpy(&triangleCount, text.data() + stlHeaderSize - sizeof(triangleCount), sizeof(triangleCount));
+
+		if (stlHeaderSize + uint64_t(triangleCount) * stlTriangleSize == text.size())
+		{
+			return false;
+		}
+	}
+
+	const char* start = text.data();
+	const char* end = start + text.size();
+
+	while (start != end && (isSpace(*start) || *start == '\n'))
+	{
+		++start;
+	}
+
+	return isKeyword(start, end, "solid", 5);
+}
+
+bool TextMeshParser::parse(const std::string& extension, std::string_view text, std::vector<Vertex>& vertices, std::vector<GLuint>& indices)
+{
+	if (extension == "stl")
+	{
+		return parseStl(text, vertices, indices);
+	}
+
+	if (extension == "obj")
+	{
+		return parseObj(text, vertices, indices);
+	}
+
+	return false;
+}
+
+bool TextMeshParser::parseStl(std::string_view text, std::vector<Vertex>& vertices, std::vector<GLuint>& indices)
+{
+	PROFILE_FUNCTION();
+
+	const std::vector<std::string_view> chunks = splitChunks(text, "endfacet");
+
+	std::vector<std::vector<Vector3f>> corners(chunks.size());
+	std::vector<std::vector<Vector3f>> normals(chunks.size());
+	std::atomic<bool> failed(false);
+
+	{
+		PROFILE_SCOPE("Parse chunks");
+
+		JobSystem::parallelFor(0, chunks.size(), 1, [&](std::size_t first, std::size_t last)
+		{
+			for (std::size_t i = first; i < last && !failed; ++i)
+			{
+				if (!parseStlChunk(chunks[i], corners[i], normals[i]))
+				{
+					failed = true;
+				}
+			}
+		});
+	}
+
+	if (failed)
+	{
+		return false;
+	}
+
+	std::size_t triangleCount = 0;
+
+	for (auto& chunk : normals)
+	{
+		triangleCount += chunk.size();
+	}
+
+	if (triangleCount == 0)
+	{
+		return false;
+	}
+
+	// Welded in file order so the vertices come out in the order they're first
+	// used. Facet normals are kept, as Assimp does, so flat faces stay flat
+	MeshWelder welder(triangleCount);
+
+	for (std::size_t i = 0; i < chunks.size(); ++i)
+	{
+		welder.addFacets(corners[i].data(), normals[i].data(), normals[i].size());
+
+		std::vector<Vector3f>().swap(corners[i]);
+		std::vector<Vector3f>().swap(normals[i]);
+	}
+
+	welder.finish(vertices, indices);
+
+	return true;
+}
+
+bool TextMeshParser::parseObj(std::string_view text, std::vector<Vertex>& vertices, std::vector<GLuint>& indices)
+{
+	PROFILE_FUNCTION();
+
+	vertices.clear();
+	indices.clear();
+
+	const std::vector<std::string_view> chunks = splitChunks(text, std::string_view());
+
+	std::vector<ObjChunk> parsed(chunks.size());
+	std::atomic<bool> failed(false);
+
+	{
+		PROFILE_SCOPE("Parse chunks");
+
+		JobSystem::parallelFor(0, chunks.size(), 1, [&](std::size_t first, std::size_t last)
+		{
+			for (std::size_t i = first; i < last && !failed; ++i)
+			{
+				if (!parseObjChunk(chunks[i], parsed[i]))
+				{
+					failed = true;
+				}
+			}
+		});
+	}
+
+	if (failed)
+	{
+		return false;
+	}
+
+	// Where each chunk's vertices start in the whole file
+	std::size_t positionCount = 0;
+	std::size_t normalCount = 0;
+	std::size_t cornerCount = 0;
+
+	for (auto& chunk : parsed)
+	{
+		chunk.positionBase = positionCount;
+		chunk.normalBase = normalCount;
+
+		positionCount += chunk.positions.size();
+		normalCount += chunk.normals.size();
+		cornerCount += chunk.corners.size();
+	}
+
+	if (cornerCount == 0 || positionCount >= noIndex || normalCount >= noIndex)
+	{
+		return false;
+	}
+
+	bool fileNormals = normalCount > 0;
+
+	JobSystem::parallelFor(0, parsed.size(), 1, [&](std::size_t first, std::size_t last)
+	{
+		for (std::size_t i = first; i < last && !failed; ++i)
+		{
+			if (!resolveChunk(parsed[i], positionCount, normalCount))
+			{
+				failed = true;
+			}
+		}
+	});
+
+	if (failed)
+	{
+		return false;
+	}
+
+	for (std::size_t i = 0; i < parsed.size() && fileNormals; ++i)
+	{
+		for (GLuint normal : parsed[i].cornerNormals)
+		{
+			if (normal == noIndex)
+			{
+				fileNormals = false;
+				break;
+			}
+		}
+	}
+
+	PROFILE_SCOPE("Merge chunks");
+
+	std::vector<Vector3f> positions;
+	std::vector<Vector3f> normals;
+
+	positions.reserve(positionCount);
+	normals.reserve(normalCount);
+
+	indices.reserve(cornerCount);
+
+	for (auto& chunk : parsed)
+	{
+		positions.insert(positions.end(), chunk.positions.begin(), chunk.positions.end());
+		normals.insert(normals.end(), chunk.normals.begin(), chunk.normals.end());
+	}
+
+	if (fileNormals)
+	{
+		// A vertex for each pairing of position and normal the faces use
+		std::unordered_map<uint64_t, GLuint> lookup(positionCount);
+
+		for (auto& chunk : parsed)
+		{
+			for (std::size_t i = 0; i < chunk.corners.size(); ++i)
+			{
+				const uint64_t key = (uint64_t(chunk.corners[i]) << 32) | chunk.cornerNormals[i];
+
+				auto inserted = lookup.emplace(key, static_cast<GLuint>(vertices.size()));
+
+				if (inserted.second)
+				{
+					const Vector3f& normal = normals[chunk.cornerNormals[i]];
+
+					vertices.push_back(Vertex(positions[chunk.corners[i]], normal.LengthSq() > 0.0f ? normal.Normalized() : normal));
+				}
+
+				indices.push_back(inserted.first->second);
+			}
+		}
+	}
+	else
+	{
+		// Faces index the positions directly, with area weighted normals
+		vertices.reserve(positionCount);
+
+		for (auto& position : positions)
+		{
+			vertices.push_back(Vertex(position, Vector3f(0.0f, 0.0f, 0.0f)));
+		}
+
+		for (auto& chunk : parsed)
+		{
+			indices.insert(indices.end(), chunk.corners.begin(), chunk.corners.end());
+		}
+
+		for (std::size_t i = 0; i + 2 < indices.size(); i += 3)
+		{
+			Vertex& a = vertices[indices[i]];
+			Vertex& b = vertices[indices[i + 1]];
+			Vertex& c = vertices[indices[i + 2]];
+
+			const Vector3f normal = (b.position - a.position).Cross(c.position - a.position);
+
+			a.normal += normal;
+			b.normal += normal;
+			c.normal += normal;
+		}
+
+		for (auto& vertex : vertices)
+		{
+			if (vertex.normal.LengthSq() > 0.0f)
+			{
+				vertex.normal = vertex.normal.Normalized();
+			}
+		}
+	}
+
+	return true;
+}
\ No newline at end of file
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "Vertex.hpp"
+
+#include "GL\glew.h"
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Parses ASCII STL and OBJ files without going through Assimp. The text is
+// split into chunks of a few megabytes, ending on a line or for STL on a
+// facet, which are parsed in parallel on the job system and then merged into
+// one indexed mesh. STL corners are welded by position and facet normal, OBJ
+// faces keep the file's own indexing. Only positions and normals are read, texture
+// coordinates, groups and materials are skipped
+namespace TextMeshParser
+{
+	// Any OBJ, or an STL that's text rather than binary. Binary STLs can start
+	// with "solid" too, so the size is checked against the triangle count
+	bool canParse(const std::string& extension, std::string_view text);
+
+	// False if the text is malformed, e.g. a number that won't parse or an
+	// index out of range, in which case the arrays are left empty
+	bool parse(const std::string& extension, std::string_view text, std::vector<Vertex>& vertices, std::vector<GLuint>& indices);
+
+	// Each triangle keeps the facet normal from the file, the same as importing
+	// it through Assimp, so corners are only shared between facets facing the
+	// same way
+	bool parseStl(std::string_view text, std::vector<Vertex>& vertices, std::vector<GLuint>& indices);
+
+	// Polygons are triangulated as fans. The file's normals are used if every
+	// face corner has one, otherwise smooth normals are generated
+	bool parseObj(std::string_view text, std::vector<Vertex>& vertices, std::vector<GLuint>& indices);
+}
\ No newline at end of file